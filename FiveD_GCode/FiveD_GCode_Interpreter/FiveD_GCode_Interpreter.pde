@@ -9,6 +9,7 @@
 #include "hostcom.h"
 #include "intercom.h"
 #include "pins.h"
+#include "fastio.h"
 #include "Temperature.h"
 #include "pid.h"
 #include "bed.h"
@@ -17,22 +18,24 @@
 
 // function prototypes:
 void blink();
-void dQMove();
+bool dQMove();
+void planMoves();
 void setupTimerInterrupt();
-void setTimer(long delay);
-void setTimerResolution(byte r);
 
 void setupGcodeProcessor();
 void init_process_string();
 void cancelAndClearQueue();
 void get_and_do_command();
+void checkHoming();
+void doQueuedCommands();
+void idleSteppers();
+void doMCode(byte m, float v, byte e);
+bool queueMCode();
 void setupThermistors();
 
 void process_string(char instruction[], int size);
 
-int scan_int(char *str, int *valp, unsigned int *seen, unsigned int flag);
-int scan_float(char *str, float *valp, unsigned int *seen, unsigned int flag);
-int scan_long(char *str, long *valp, unsigned int *seen, unsigned int flag);
+void parse_char(char c);
 
 
 /**
@@ -62,8 +65,13 @@ http://objects.reprap.org/wiki/Mendel_User_Manual:_RepRapGCodes
 
 // Maintain a list of extruders...
 
+// extruder_in_use is the one the machine is using now.  extruder_queued is the
+// one the G codes read so far have selected; the interrupt changes over to it
+// when it gets to the tool change in the queue.
+
 extruder* ex[EXTRUDER_COUNT];
 byte extruder_in_use = 0;
+byte extruder_queued = 0;
 
 
 
@@ -132,17 +140,29 @@ static bed heatedBed(BED_HEATER_PIN, BED_TEMPERATURE_PIN);
 
 static hostcom talkToHost;
 
-// Each entry in the buffer is an instance of cartesian_dda.
+// Each entry in the buffer is a MoveBlock; the one cartesian_dda
+// works them out and then steps through them.
 
-cartesian_dda* cdda[BUFFER_SIZE];
+MoveBlock moves[BUFFER_SIZE];
 
-static cartesian_dda cdda0;
-static cartesian_dda cdda1;
-static cartesian_dda cdda2;
-static cartesian_dda cdda3;
+static cartesian_dda dda;
 
 volatile byte head;
 volatile byte tail;
+
+// M codes from the queue that the interrupt has got to, waiting for
+// doQueuedCommands().  It can't get more than a queue's worth (plus the
+// one being done) ahead.
+
+#define COMMAND_BUFFER (BUFFER_SIZE + 1)
+
+byte command_codes[COMMAND_BUFFER];
+float command_values[COMMAND_BUFFER];
+byte command_extruders[COMMAND_BUFFER]; // The extruder in use when we got there
+bool command_holds[COMMAND_BUFFER];
+volatile byte command_head;
+volatile byte command_tail;
+volatile bool queue_hold;      // Stopped till one of them's done
 bool led;
 
 word interruptBlink;
@@ -159,6 +179,16 @@ LongPoint zeroHit;
 
 volatile byte endstop_hits;
 
+// Homing moves that didn't end on their endstops (see checkHoming())
+
+volatile byte homing_faults;
+
+// Queue statistics
+
+unsigned int queue_slowdowns;
+unsigned int queue_underruns;
+bool queue_streaming;
+
 // Our interrupt function
 
 /*
@@ -170,8 +200,16 @@ communications errors.
 
 volatile bool nonest;
 
+// Long waits (see setTimerTicks())
+
+unsigned long timer_wait_laps;
+volatile unsigned long timer_laps;
+unsigned int timer_last;
+
 ISR(TIMER1_COMPA_vect)
 {
+  if(timerLap())
+    return;
   if(nonest)
     return;
   nonest = true;
@@ -184,17 +222,58 @@ ISR(TIMER1_COMPA_vect)
   }
 
       
-  if(cdda[tail]->active())
-      cdda[tail]->dda_step();
-  else
+  if(dda.active())
+  {
+      dda.dda_step();
+      
+      // If that was the last step of the block start the next one now, so
+      // there's no gap between them
+      
+      if(!dda.active() && !dQMove())
+        dda.dda_stop();
+  } else
       dQMove();
   nonest = false;
 }
 
+#if ENDSTOP_INTERRUPTS
+
+// Pin change interrupts for the endstops.  It doesn't matter which one
+// changed; read_endstops() latches the lot.
+
+ISR(PCINT0_vect)
+{
+  dda.read_endstops();
+}
+
+ISR(PCINT1_vect)
+{
+  dda.read_endstops();
+}
+
+ISR(PCINT2_vect)
+{
+  dda.read_endstops();
+}
+
+#ifdef PCINT3_vect
+ISR(PCINT3_vect)
+{
+  dda.read_endstops();
+}
+#endif
+
+#endif
+
 void setup()
 {
   nonest = false;
+  timer_wait_laps = 0;
   endstop_hits = 0;
+  homing_faults = 0;
+  queue_slowdowns = 0;
+  queue_underruns = 0;
+  queue_streaming = false;
   disableTimerInterrupt();
   setupTimerInterrupt();
   interruptBlink = 0;
@@ -210,17 +289,15 @@ void setup()
   ex[1] = &ex1;
 #endif  
   extruder_in_use = 0; 
+  extruder_queued = 0;
   
   head = 0;
   tail = 0;
+  command_head = 0;
+  command_tail = 0;
+  queue_hold = false;
   
-  cdda[0] = &cdda0;
-  cdda[1] = &cdda1;  
-  cdda[2] = &cdda2;  
-  cdda[3] = &cdda3;
-  
-  for(byte i = 0; i < 4; i++)
-    cdda[i]->set_units(true);
+  dda.set_units(true);
   
   //setExtruder();
   
@@ -242,7 +319,7 @@ void setup()
 rs485Interface.begin(RS485_BAUD);  
 #endif
 
-  setTimer(DEFAULT_TICK);
+  setTimerTicks(DEFAULT_TIMER_TICKS);
   enableTimerInterrupt();
 }
 
@@ -302,6 +379,25 @@ void manage()
 #if HEATED_BED == HEATED_BED_ON   
   heatedBed.manage();
 #endif  
+  checkHoming();
+  doQueuedCommands();
+  idleSteppers();
+}
+
+// Switch the steppers off when there's been nothing to do for
+// STEPPER_IDLE_TIME milliseconds.  Nothing can start while the queue is
+// empty but for us, so the interrupt won't want them back meanwhile.
+
+void idleSteppers()
+{
+  static unsigned long busy = 0;
+  if(!qEmpty())
+  {
+    busy = millis();
+    return;
+  }
+  if(dda.steppers_enabled() && millis() - busy > STEPPER_IDLE_TIME)
+    dda.disable_steppers();
 }
 
 //long count = 0;
@@ -375,8 +471,9 @@ void validate_hardware() {
 inline void cancelAndClearQueue()
 {
 	tail = head;	// clear buffer
-	for(int i=0;i<BUFFER_SIZE;i++)
-		cdda[i]->shutdown();
+	command_tail = command_head;
+	queue_hold = false;
+	dda.shutdown();
 }
 
 inline void waitFor_qEmpty()
@@ -385,6 +482,9 @@ inline void waitFor_qEmpty()
   while(!qEmpty()) {
     manage();
   }
+  
+// We emptied it on purpose, so the next move doesn't count as an underrun
+  queue_streaming = false;
 }
  
 inline void waitFor_qNotFull()
@@ -405,42 +505,373 @@ inline bool qFull()
 
 inline bool qEmpty()
 {
-   return tail == head && !cdda[tail]->active();
+   return tail == head && !dda.active() && command_tail == command_head;
+}
+
+// How long the moves in the queue (including the one running) take
+// at their nominal feedrates, in milliseconds
+
+float queuedTime()
+{
+  byte i = tail;
+  float t = 0.0;
+  if(dda.active())
+    t = moves[i].time;
+  while(i != head)
+  {
+    i++;
+    if(i >= BUFFER_SIZE)
+      i = 0;
+    t += moves[i].time;
+  }
+  return t;
+}
+
+// Queue a move to p.  must_hit is for homing: the endstops (X_LOW_HIT etc.)
+// the move has to finish on.
+
+inline void qMove(const FloatPoint& p, byte must_hit)
+{
+  waitFor_qNotFull();
+  doQueuedCommands();
+  
+  // Markers for G92 and the like take no time, and the moves after them
+  // start from rest if there's nothing else in front of them
+  
+  float buffered = queuedTime();
+  bool queued = buffered > 0.0;
+  if(queue_streaming && !queued)
+    queue_underruns++;
+  byte h = head; 
+  h++;
+  if(h >= BUFFER_SIZE)
+    h = 0;
+  dda.set_target(p, moves[h], queued, buffered);
+  
+  // Don't clog up the buffer with things that take no time
+  
+  if(!moves[h].total_steps)
+    return;
+  moves[h].must_hit = must_hit;
+  moves[h].command = 0;
+  
+  head = h;
+  queue_streaming = true;
+  planMoves();
 }
 
 inline void qMove(const FloatPoint& p)
+{
+  qMove(p, 0);
+}
+
+// Queue M code m, with S or P value v, to be done when the moves in front
+// of it have been.  If hold is set the machine stops till it's done.
+
+void qCommand(byte m, float v, bool hold)
+{
+  waitFor_qNotFull();
+  doQueuedCommands();
+  byte h = head; 
+  h++;
+  if(h >= BUFFER_SIZE)
+    h = 0;
+  moves[h].command = m;
+  moves[h].command_value = v;
+  moves[h].hold = hold;
+  moves[h].total_steps = 0;
+  moves[h].time = 0.0;
+  moves[h].must_hit = 0;
+  head = h;
+  planMoves();
+}
+
+// Queue a change of position to p (G92, homing...), so the interrupt's
+// step count keeps up with the coordinates the G codes are using.
+
+void setPosition(const FloatPoint& p)
+{
+  waitFor_qNotFull();
+  doQueuedCommands();
+  byte h = head; 
+  h++;
+  if(h >= BUFFER_SIZE)
+    h = 0;
+  dda.set_position(p, moves[h]);
+  moves[h].command = SET_POSITION;
+  moves[h].hold = false;
+  moves[h].total_steps = 0;
+  moves[h].time = 0.0;
+  moves[h].must_hit = 0;
+  head = h;
+  planMoves();
+}
+
+// Queue a change to extruder e.  The moves after it are worked out for e
+// already (see newExtruder()), and so is where_i_am, which the interrupt
+// counts E from when it changes over.
+
+void qToolChange(byte e)
 {
   waitFor_qNotFull();
+  doQueuedCommands();
   byte h = head; 
   h++;
   if(h >= BUFFER_SIZE)
     h = 0;
-  cdda[h]->set_target(p);
+  dda.set_position(where_i_am, moves[h]);
+  moves[h].command = TOOL_CHANGE;
+  moves[h].command_value = e;
+  moves[h].hold = false;
+  moves[h].total_steps = 0;
+  moves[h].time = 0.0;
+  moves[h].must_hit = 0;
   head = h;
+  planMoves();
 }
 
-inline void dQMove()
+// Queue a G4 pause of ms milliseconds.  The machine stops for it, but
+// the host can carry on sending.
+
+void qDwell(float ms)
 {
-  if(qEmpty())
+  ms = round(ms);
+  if(ms < 1.0)
     return;
-  byte t = tail;  
-  t++;
-  if(t >= BUFFER_SIZE)
-    t = 0;
-  cdda[t]->dda_start();
-  tail = t; 
+  waitFor_qNotFull();
+  doQueuedCommands();
+  byte h = head; 
+  h++;
+  if(h >= BUFFER_SIZE)
+    h = 0;
+  moves[h].command = DWELL;
+  moves[h].command_value = ms;
+  moves[h].hold = true;
+  moves[h].total_steps = 0;
+  moves[h].time = ms;
+  moves[h].must_hit = 0;
+  head = h;
+  planMoves();
 }
 
-inline void setUnits(bool u)
+// Do the M codes the queue has got to
+
+void doQueuedCommands()
+{
+  static bool busy = false;
+  if(busy)
+    return;     // Some of them call manage() while they wait
+  busy = true;
+  while(command_tail != command_head)
+  {
+    byte c = command_tail;
+    bool hold = command_holds[c];
+    doMCode(command_codes[c], command_values[c], command_extruders[c]);
+    if(++c >= COMMAND_BUFFER)
+      c = 0;
+    command_tail = c;
+    if(hold)
+      queue_hold = false;
+  }
+  busy = false;
+}
+
+// Look-ahead.  Go backwards from the newest move working out the fastest
+// each one can be entered and still leave room to stop by the end of the
+// queue, then forwards making sure each of those speeds can be reached from
+// the one before.  If the interrupt starts a move while we're doing this, 
+// its profile is fixed, so just go round again.
+//
+// As grbl does, only go back as far as a new move can make a difference.
+// planned is the last move whose entry speed nothing after it can change:
+// it's as fast as its corner allows, or it can't get up to speed from the
+// move before, or there's a hold in front of it.  The backwards pass also
+// stops at any move whose entry speed comes out the same as last time.
+// The forwards pass starts from wherever the backwards one stopped.
+
+byte planned;
+
+inline byte queue_place(byte i, byte t)
+{
+  return (i + BUFFER_SIZE - t) % BUFFER_SIZE;
+}
+
+void planMoves()
 {
-   for(byte i = 0; i < BUFFER_SIZE; i++)
-     cdda[i]->set_units(u); 
+#if ACCELERATION == ACCELERATION_ON
+  float entry[BUFFER_SIZE];
+  SpeedProfile p;
+  byte t, i, j, s;
+  float v, exit;
+  bool collided, fixed;
+  
+  do
+  {
+    t = tail;
+    if(t == head)
+      return;
+      
+    // Has the interrupt gone past the planned move (and the queue come round
+    // to its slot again)?
+    
+    if(planned == head || queue_place(planned, t) > queue_place(head, t))
+      planned = t;
+    
+    // Backwards, from a stop at the end.  A speed of 0 means stop, which
+    // a move can do from its min_feedrate.  M codes in the queue don't
+    // change the speed, unless they need the machine to stop for them.
+    
+    i = head;
+    s = t;
+    v = 0.0;
+    for(;;)
+    {
+      if(moves[i].command)
+      {
+        if(moves[i].hold)
+          v = 0.0;
+      } else
+      {
+        if(v <= 0.0)
+          v = moves[i].min_feedrate;
+        v = dda.entry_limit(moves[i], v);
+        if(i != head && (v == moves[i].entry_feedrate ||
+                moves[i].entry_feedrate >= moves[i].max_entry_feedrate))
+        {
+          s = i;
+          break;
+        }
+      }
+      entry[i] = v;
+      j = (i == 0) ? BUFFER_SIZE - 1 : i - 1;
+      if(j == t)
+        break;
+      if(j == planned)
+      {
+        s = j;
+        i = j;
+        break;
+      }
+      i = j;
+    }
+    
+    // Forwards, from a move whose entry speed stays as it was, or from
+    // wherever the move now running will leave off
+    
+    fixed = (s != t);
+    if(fixed)
+      v = moves[i].entry_feedrate;
+    else
+      v = dda.active() ? dda.planned_exit(moves[t]) : 0.0;
+    
+    for(;;)
+    {
+      j = (i == BUFFER_SIZE - 1) ? 0 : i + 1;
+      if(moves[i].command)
+      {
+        if(moves[i].hold)
+          v = 0.0;
+        exit = v;
+        moves[i].entry_feedrate = v;
+        collided = false;
+        if(moves[i].hold && !fixed)
+          planned = i;
+      } else
+      {
+        if(v <= 0.0)
+          v = moves[i].min_feedrate;
+        if(!fixed && v > entry[i])
+          v = entry[i];
+        if(i == head)
+          exit = 0.0;
+        else
+          exit = entry[j];
+        if(exit <= 0.0)
+          exit = moves[i].min_feedrate;
+        exit = min(exit, dda.exit_limit(moves[i], v));
+        dda.plan_profile(moves[i], v, exit, p);
+      
+        cli();
+        collided = (tail != t);
+        if(!collided)
+          moves[i].profile = p;
+        sei();
+        
+        if(!collided)
+        {
+          moves[i].entry_feedrate = v;
+          if(!fixed && (v < entry[i] || v >= moves[i].max_entry_feedrate))
+            planned = i;
+        }
+      }
+      
+      if(collided || i == head)
+        break;
+      fixed = false;
+      v = exit;
+      i = j;
+    }
+  } while(collided);
+#endif
 }
 
+inline bool dQMove()
+{
+  while(tail != head && !queue_hold)
+  {
+    byte t = tail;  
+    t++;
+    if(t >= BUFFER_SIZE)
+      t = 0;
+      
+    // A new position?  Count from there and carry on.
+    
+    if(moves[t].command == SET_POSITION)
+    {
+      dda.reset_position(moves[t]);
+      tail = t;
+      continue;
+    }
+    
+    // An M code?  Hand it on to doQueuedCommands() and carry on, unless
+    // it needs us to stop.  (A pause is run like a move.)  A new extruder
+    // is stepped from here on, and doQueuedCommands() switches the old one
+    // off - on RS485 that's a trip over the bus, which we can't wait for here.
+    
+    if(moves[t].command && moves[t].command != DWELL)
+    {
+      byte c = command_head;
+      command_codes[c] = moves[t].command;
+      command_values[c] = moves[t].command_value;
+      command_extruders[c] = extruder_in_use;
+      command_holds[c] = moves[t].hold;
+      if(++c >= COMMAND_BUFFER)
+        c = 0;
+      command_head = c;
+      if(moves[t].command == TOOL_CHANGE)
+      {
+        extruder_in_use = (byte)moves[t].command_value;
+        dda.reset_position(moves[t]);
+      }
+      tail = t;
+      if(moves[t].hold)
+        queue_hold = true;
+      continue;
+    }
+    
+    dda.dda_start(&moves[t]);
+    tail = t; 
+    return true;
+  }
+  return false;
+}
+
+// The same numbers mean different steps now, so where_i_am has moved
 
-inline void setPosition(const FloatPoint& p)
+inline void setUnits(bool u)
 {
-  where_i_am = p;  
+   dda.set_units(u); 
+   setPosition(where_i_am);
 }
 
 void blink()
@@ -477,137 +908,11 @@ void setupTimerInterrupt()
 	TCCR1A &= ~(1<<COM1B1); 
 	TCCR1A &= ~(1<<COM1B0);
 
-	//start off with a slow frequency.
-	setTimerResolution(4);
+	//clk/8, for good - see setTimerTicks()
+	TCCR1B |=  (1<<CS11);
 	setTimerCeiling(65535);
 }
 
-void setTimerResolution(byte r)
-{
-	//here's how you figure out the tick size:
-	// 1000000 / ((16000000 / prescaler))
-	// 1000000 = microseconds in 1 second
-	// 16000000 = cycles in 1 second
-	// prescaler = your prescaler
-
-	// no prescaler == 0.0625 usec tick
-	if (r == 0)
-	{
-		// 001 = clk/1
-		TCCR1B &= ~(1<<CS12);
-		TCCR1B &= ~(1<<CS11);
-		TCCR1B |=  (1<<CS10);
-	}	
-	// prescale of /8 == 0.5 usec tick
-	else if (r == 1)
-	{
-		// 010 = clk/8
-		TCCR1B &= ~(1<<CS12);
-		TCCR1B |=  (1<<CS11);
-		TCCR1B &= ~(1<<CS10);
-	}
-	// prescale of /64 == 4 usec tick
-	else if (r == 2)
-	{
-		// 011 = clk/64
-		TCCR1B &= ~(1<<CS12);
-		TCCR1B |=  (1<<CS11);
-		TCCR1B |=  (1<<CS10);
-	}
-	// prescale of /256 == 16 usec tick
-	else if (r == 3)
-	{
-		// 100 = clk/256
-		TCCR1B |=  (1<<CS12);
-		TCCR1B &= ~(1<<CS11);
-		TCCR1B &= ~(1<<CS10);
-	}
-	// prescale of /1024 == 64 usec tick
-	else
-	{
-		// 101 = clk/1024
-		TCCR1B |=  (1<<CS12);
-		TCCR1B &= ~(1<<CS11);
-		TCCR1B |=  (1<<CS10);
-	}
-}
-
-unsigned int getTimerCeiling(const long& delay)
-{
-	// our slowest speed at our highest resolution ( (2^16-1) * 0.0625 usecs = 4095 usecs)
-	if (delay <= 65535L)
-		return (delay & 0xffff);
-	// our slowest speed at our next highest resolution ( (2^16-1) * 0.5 usecs = 32767 usecs)
-	else if (delay <= 524280L)
-		return ((delay / 8) & 0xffff);
-	// our slowest speed at our medium resolution ( (2^16-1) * 4 usecs = 262140 usecs)
-	else if (delay <= 4194240L)
-		return ((delay / 64) & 0xffff);
-	// our slowest speed at our medium-low resolution ( (2^16-1) * 16 usecs = 1048560 usecs)
-	else if (delay <= 16776960L)
-		return ((delay / 256) & 0xffff);
-	// our slowest speed at our lowest resolution ((2^16-1) * 64 usecs = 4194240 usecs)
-	else if (delay <= 67107840L)
-		return ((delay / 1024) & 0xffff);
-	//its really slow... hopefully we can just get by with super slow.
-	else
-		return 65535;
-}
-
-byte getTimerResolution(const long& delay)
-{
-	// these also represent frequency: 1000000 / delay / 2 = frequency in hz.
-	
-	// our slowest speed at our highest resolution ( (2^16-1) * 0.0625 usecs = 4095 usecs (4 millisecond max))
-	// range: 8Mhz max - 122hz min
-	if (delay <= 65535L)
-		return 0;
-	// our slowest speed at our next highest resolution ( (2^16-1) * 0.5 usecs = 32767 usecs (32 millisecond max))
-	// range:1Mhz max - 15.26hz min
-	else if (delay <= 524280L)
-		return 1;
-	// our slowest speed at our medium resolution ( (2^16-1) * 4 usecs = 262140 usecs (0.26 seconds max))
-	// range: 125Khz max - 1.9hz min
-	else if (delay <= 4194240L)
-		return 2;
-	// our slowest speed at our medium-low resolution ( (2^16-1) * 16 usecs = 1048560 usecs (1.04 seconds max))
-	// range: 31.25Khz max - 0.475hz min
-	else if (delay <= 16776960L)
-		return 3;
-	// our slowest speed at our lowest resolution ((2^16-1) * 64 usecs = 4194240 usecs (4.19 seconds max))
-	// range: 7.812Khz max - 0.119hz min
-	else if (delay <= 67107840L)
-		return 4;
-	//its really slow... hopefully we can just get by with super slow.
-	else
-		return 4;
-}
-
-
-// Depending on how much work the interrupt function has to do, this is
-// pretty accurate between 10 us and 0.1 s.  At fast speeds, the time
-// taken in the interrupt function becomes significant, of course.
-
-// Note - it is up to the user to call enableTimerInterrupt() after a call
-// to this function.
-
-inline void setTimer(long delay)
-{
-	// delay is the delay between steps in microsecond ticks.
-	//
-	// we break it into 5 different resolutions based on the delay. 
-	// then we set the resolution based on the size of the delay.
-	// we also then calculate the timer ceiling required. (ie what the counter counts to)
-	// the result is the timer counts up to the appropriate time and then fires an interrupt.
-
-        // Actual ticks are 0.0625 us, so multiply delay by 16
-        
-        delay <<= 4;
-        
-	setTimerCeiling(getTimerCeiling(delay));
-	setTimerResolution(getTimerResolution(delay));
-}
-
 
 void delayMicrosecondsInterruptible(unsigned int us)
 {
@@ -10,7 +10,139 @@
 #ifndef CARTESIAN_DDA_H
 #define CARTESIAN_DDA_H
 
-// Main class for moving the RepRap machine about
+#include <util/delay.h>
+#include "speed_lookuptable.h"
+
+// Bits in MoveBlock::directions - set for going in the + direction
+
+#define X_PLUS 1
+#define Y_PLUS 2
+#define Z_PLUS 4
+#define E_PLUS 8
+
+// MoveBlock::command values that aren't M codes.  The interrupt does these
+// itself: a change of extruder (T), a new position to count steps from (G92,
+// homing, a change of units) and a pause (G4).
+
+#define TOOL_CHANGE 253
+#define SET_POSITION 254
+#define DWELL 255
+
+// The speed profile of a move, as worked out by the look-ahead planner.
+// Rates are steps per second along the longest axis (1 to MAX_STEP_RATE).  The interrupt speeds
+// up and slows down at the block's acceleration_rate, so the ramps are
+// linear in time; the planner works out where along the move they end.
+
+struct SpeedProfile
+{
+  unsigned int initial_rate;   // Step rate at the start...
+  unsigned int peak_rate;      // ...in the middle...
+  unsigned int final_rate;     // ...and at the end
+  long accelerate_until;       // Step at which to stop speeding up...
+  long decelerate_after;       // ...and at which to start slowing down
+};
+
+// A move waiting in the queue.  Everything the interrupt needs is worked
+// out when the move is queued and kept here as integers; the floats at the
+// end are only used by the look-ahead planner.
+
+struct MoveBlock
+{
+  long x_steps;                // How far to go on each axis (where we are now, for SET_POSITION)
+  long y_steps;
+  long z_steps;
+  long e_steps;
+  long total_steps;            // The number of steps to take along the longest movement axis
+  byte directions;             // X_PLUS etc.
+  byte must_hit;               // Endstops (X_LOW_HIT etc.) a homing move has to finish on
+  byte command;                // Not a move but an M code to do when we get here (0 for moves)...
+  float command_value;         // ...its S or P value (milliseconds for DWELL, the extruder for TOOL_CHANGE)...
+  bool hold;                   // ...and whether to stop moving till it's done
+  unsigned int acceleration_rate; // Step rate change per timer tick, with 16 fractional bits
+  SpeedProfile profile;
+
+  float distance;              // mm (or inches)
+  float nominal_feedrate;      // The feedrate asked for
+  float min_feedrate;          // The feedrate we can start or stop dead from
+  float max_entry_feedrate;    // The fastest we can take the corner into this move
+  float entry_feedrate;        // The speed planMoves() has it starting at
+  float acceleration;          // mm/second/second along the move, from the slowest axis
+  float time;                  // Milliseconds it takes at the nominal feedrate
+};
+
+#if MOVEMENT_TYPE == MOVEMENT_TYPE_STEP_DIR
+
+// What the interrupt needs to know about each axis.  It's all template
+// parameters, so the compiler turns each axis' share of a step into a
+// couple of port instructions, and leaves the endstop test out altogether
+// for the endstops we haven't got.
+
+template <uint8_t step_pin, uint8_t dir_pin, bool invert_dir, byte endstops>
+struct StepperAxis
+{
+  // Start a step pulse; end_step() finishes it (see cartesian_dda::end_steps())
+  
+  static inline void step()
+  {
+    fastDigitalWrite(step_pin, HIGH);
+  }
+  
+  static inline void end_step()
+  {
+    fastDigitalWrite(step_pin, LOW);
+  }
+  
+  static inline void set_direction(bool forward)
+  {
+    fastDigitalWrite(dir_pin, forward != invert_dir);
+  }
+  
+  // Has one of our endstops stopped us?
+  
+  static inline bool stopped(byte hits)
+  {
+    return hits & endstops;
+  }
+};
+
+#define AXIS_ENDSTOPS(low, high) ((ENDSTOPS_MIN_ENABLED == 1 ? low : 0) | (ENDSTOPS_MAX_ENABLED == 1 ? high : 0))
+
+typedef StepperAxis<X_STEP_PIN, X_DIR_PIN, INVERT_X_DIR, AXIS_ENDSTOPS(X_LOW_HIT, X_HIGH_HIT)> XAxis;
+typedef StepperAxis<Y_STEP_PIN, Y_DIR_PIN, INVERT_Y_DIR, AXIS_ENDSTOPS(Y_LOW_HIT, Y_HIGH_HIT)> YAxis;
+typedef StepperAxis<Z_STEP_PIN, Z_DIR_PIN, INVERT_Z_DIR, AXIS_ENDSTOPS(Z_LOW_HIT, Z_HIGH_HIT)> ZAxis;
+
+// The extruder drives its own stepper, and has no endstops
+
+struct ExtruderAxis
+{
+  static inline void step()
+  {
+    ex[extruder_in_use]->sStep();
+  }
+  
+  static inline void end_step()
+  {
+    ex[extruder_in_use]->sStepEnd();
+  }
+  
+  static inline void set_direction(bool forward)
+  {
+    ex[extruder_in_use]->setDirection(forward);
+  }
+  
+  static inline bool stopped(byte hits)
+  {
+    return false;
+  }
+};
+
+typedef ExtruderAxis EAxis;
+
+#endif
+
+// Main class for moving the RepRap machine about.  There is only one
+// of these; it turns G1 targets into MoveBlocks for the queue, and the
+// interrupt uses it to step through the block at the front of the queue.
 
 class cartesian_dda
 {
@@ -19,86 +151,152 @@ private:
 
   bool using_mm;
   FloatPoint units;            // Factors for converting either mm or inches to steps
+  LongPoint step_length;       // Nanometres per step on each axis
+  LongPoint step_limit;        // The most steps whose step_length fits in a long
+  float nm_to_units;           // ...and for converting nanometres back to mm or inches
+
+// The last position queued, and the same in steps, so that's not worked out twice
+
+  FloatPoint queued_position;
+  LongPoint queued_steps;
+  bool queued_valid;
 
-  FloatPoint target_position;  // Where it's going
-  FloatPoint delta_position;   // The difference between the two
-  float distance;              // How long the path is
+// Where the previous move queued was going, for working out corners
+
+  FloatPoint last_unit_vector;
+  float last_nominal_feedrate;
+  float last_min_feedrate;
+
+// The move being stepped through
+
+  MoveBlock* block;
   
-  LongPoint current_steps;     // Similar information as above in steps rather than units
+  LongPoint current_steps;     // Where we are in steps
   LongPoint target_steps;
-  LongPoint delta_steps;
-  LongPoint dda_counter;       // DDA error-accumulation variables
-  long t_scale;                // When doing lots of t steps, scale them so the DDA doesn't spend for ever on them
-  
-  volatile bool x_direction;            // Am I going in the + or - direction?
-  volatile bool y_direction;
-  volatile bool z_direction;
-  volatile bool e_direction;
-  volatile bool f_direction;
-
-  volatile bool x_can_step;             // Am I not at an endstop?  Have I not reached the target? etc.
-  volatile bool y_can_step;
-  volatile bool z_can_step;
-  volatile bool e_can_step;
-  volatile bool f_can_step;
+  LongPoint dda_counter;       // DDA error-accumulation variables...
+  LongPoint dda_increment;     // ...what they go up by each interrupt...
+  long dda_total;              // ...and down by when they step
+  
+  // Only the interrupt uses these, so they needn't be volatile
+  
+  bool x_direction;            // Am I going in the + or - direction?
+  bool y_direction;
+  bool z_direction;
+  bool e_direction;
+
+  bool x_can_step;             // Am I not at an endstop?  Have I not reached the target? etc.
+  bool y_can_step;
+  bool z_can_step;
+  bool e_can_step;
+  
+  volatile byte endstops;      // The endstops that are triggered now (X_LOW_HIT etc.)
+  byte stop_mask;              // The ones that would stop the move we're doing
+  bool poll_endstops;          // No pin change interrupts - read them every step
 
 // Variables for acceleration calculations
 
-  volatile long total_steps;            // The number of steps to take along the longest movement axis
+  volatile long step_count;             // How many steps along the longest axis we've done
+  unsigned long rate;                   // Steps per second, with 16 fractional bits
   
-  long timestep;               // microseconds
-  bool nullmove;               // this move is zero length
-  volatile bool real_move;     // Flag to know if we've changed something physical
-  volatile bool feed_change;   // Flag to know if feedrate has changed
+  unsigned long timestep;      // timer ticks between interrupts
+  byte step_loops;             // Steps to take each interrupt
+  byte smoothing;              // Interrupts per step are 2^smoothing...
+  byte smooth_count;           // ...and this counts them off
+  bool real_move;              // Flag to know if we've changed something physical
+  bool feed_change;            // Flag to know if feedrate has changed
   volatile bool live;          // Flag for when we're plotting a line
+  volatile bool steppers_on;   // Flag for when they need switching off
+  bool dwelling;               // Flag for a G4 pause
 
 // Internal functions that need not concern the user
 
-  // Take a single step
+  // One axis' share of a step of the DDA; Axis is XAxis etc.
 
-  void do_x_step();               
-  void do_y_step();
-  void do_z_step();
-  void do_e_step();
+  template <class Axis> void dda_axis(bool can, long& counter, long increment, long& current, bool forward);
+  
+  // Take the step pins low again once the pulses are long enough
+  
+  void end_steps();
   
-  // Can this axis step?
+  // Is there anything left to step, given the endstops that have stopped us?
   
-  bool xCanStep(long current, long target, bool dir);
-  bool yCanStep(long current, long target, bool dir);
-  bool zCanStep(long current, long target, bool dir);
-  bool eCanStep(long current, long target, bool dir);
-  bool fCanStep(long current, long target, bool dir);
+  bool can_step(byte stopped);
   
-  // Read a limit switch
+  // Set up pin change interrupts for the endstops; false if we'll have to poll them
   
-  //bool read_switch(byte pin, bool inv);
+  bool endstop_interrupts();
   
-  // Work out the number of microseconds between steps
+  // Work out the number of timer ticks between steps, and set the timer
   
-  long calculate_feedrate_delay(const float& feedrate);
+  unsigned int calculate_feedrate_delay(unsigned int r);
+  void set_step_timer();
   
-  // Switch the steppers on and off
+  // How much the rate goes up or down by between one interrupt and the next
+  
+  unsigned long rate_change();
+  
+  // Work out how fast we can take the corner into a block
+  
+  void set_junction(MoveBlock& b, const FloatPoint& unit_vector);
+  
+  // Switch on the steppers a block needs
   
   void enable_steppers();
-  void disable_steppers();
   
   
 public:
 
   cartesian_dda();
   
-  // Set where I'm going
+  // Work out the block to go from where_i_am to p.  If the queue isn't
+  // empty the previous move queued is assumed to come just before it, and
+  // buffered is how many milliseconds of moves are in front of it.
+  // A block with no steps to take needn't be queued.
+  
+  void set_target(const FloatPoint& p, MoveBlock& b, bool queued, float buffered);
+  
+  // Make b a SET_POSITION marker for p; moves queued after it start from there
+  
+  void set_position(const FloatPoint& p, MoveBlock& b);
   
-  void set_target(const FloatPoint& p);
+  // The interrupt has got to a SET_POSITION marker
   
-  // Start the DDA
+  void reset_position(const MoveBlock& b);
   
-  void dda_start();
+  // Start the DDA on a block
+  
+  void dda_start(MoveBlock* b);
   
   // Do one step of the DDA
   
   void dda_step();
   
+  // Stop stepping when the queue runs dry
+  
+  void dda_stop();
+  
+  // Switch the steppers off (those with DISABLE_X etc. set).  The steppers
+  // stay on while the queue is busy; idleSteppers() does this when it isn't.
+  
+  void disable_steppers();
+  bool steppers_enabled();
+  
+  // Latch the state of the endstops
+  
+  void read_endstops();
+  
+  // Look-ahead planning.  The fastest we can enter or leave a block given
+  // the speed at the other end, and the speed profile between given entry
+  // and exit.  Feedrates are in mm/minute.
+  
+  float entry_limit(const MoveBlock& b, float exit);
+  float exit_limit(const MoveBlock& b, float entry);
+  void plan_profile(const MoveBlock& b, float entry, float exit, SpeedProfile& p);
+  
+  // The feedrate a block has been planned to finish at
+  
+  float planned_exit(const MoveBlock& b);
+  
   // Are we running at the moment?
   
   bool active();
@@ -107,6 +305,10 @@ public:
   
   bool extruding();
   
+  // Where the steppers have actually got to, in mm or inches
+  
+  FloatPoint position();
+  
   // True for mm; false for inches
   
   void set_units(bool using_mm);
@@ -138,271 +340,174 @@ inline bool cartesian_dda::active()
   return live;
 }
 
+inline bool cartesian_dda::steppers_enabled()
+{
+  return steppers_on;
+}
+
 inline bool cartesian_dda::extruding()
 {
   return live && (current_steps.e != target_steps.e);
 }
 
+// current_steps is four longs the interrupt changes under us, so take a copy with it off.
+// Its E is in the steps of the extruder the interrupt is running, which isn't the
+// one units is for while a T is still in the queue.
 
-//HINT: #if MOVEMENT_TYPE == MOVEMENT_TYPE_GRAY_CODE  see cartesian_dda.pde, as the are not "inline"
-
-#if MOVEMENT_TYPE == MOVEMENT_TYPE_STEP_DIR
-inline void cartesian_dda::do_x_step()
+inline FloatPoint cartesian_dda::position()
 {
-	digitalWrite(X_STEP_PIN, HIGH);
-	digitalWrite(X_STEP_PIN, LOW);
+  cli();
+  LongPoint s = current_steps;
+  byte e = extruder_in_use;
+  sei();
+  FloatPoint u = units;
+  u.e = ex[e]->stepsPerMM();
+  if(!using_mm)
+    u.e *= INCHES_TO_MM;
+  return from_steps(u, s);
 }
 
-inline void cartesian_dda::do_y_step()
+inline void cartesian_dda::reset_position(const MoveBlock& b)
 {
-	digitalWrite(Y_STEP_PIN, HIGH);
-	digitalWrite(Y_STEP_PIN, LOW);
+  current_steps.x = b.x_steps;
+  current_steps.y = b.y_steps;
+  current_steps.z = b.z_steps;
+  current_steps.e = b.e_steps;
+  target_steps = current_steps;
 }
 
-inline void cartesian_dda::do_z_step()
+inline bool cartesian_dda::can_step(byte stopped)
 {
-	digitalWrite(Z_STEP_PIN, HIGH);
-	digitalWrite(Z_STEP_PIN, LOW);
+  x_can_step = current_steps.x != target_steps.x && !XAxis::stopped(stopped);
+  y_can_step = current_steps.y != target_steps.y && !YAxis::stopped(stopped);
+  z_can_step = current_steps.z != target_steps.z && !ZAxis::stopped(stopped);
+  e_can_step = current_steps.e != target_steps.e && !EAxis::stopped(stopped);
+  return x_can_step || y_can_step || z_can_step || e_can_step;
 }
 
-inline void cartesian_dda::do_e_step()
+inline float cartesian_dda::planned_exit(const MoveBlock& b)
 {
-        ex[extruder_in_use]->sStep();
+  if(!b.total_steps)
+    return 0.0;
+  return (60.0*b.distance*b.profile.final_rate)/(float)b.total_steps;
 }
-#endif
 
-//TODO implement running a makerbot DC extruder here? 
-#if MOVEMENT_TYPE == MOVEMENT_TYPE_UNMANAGED_DC
-#error TODO need to fully implement running a makerbot DC extruder from reprap firmware
-#endif
 
-inline long cartesian_dda::calculate_feedrate_delay(const float& feedrate)
-{  
-        
-	// Calculate delay between steps in microseconds.  Here it is in English:
-        // (feedrate is in mm/minute, distance is in mm)
-	// 60000000.0*distance/feedrate  = move duration in microseconds
-	// move duration/total_steps = time between steps for master axis.
+//HINT: #if MOVEMENT_TYPE == MOVEMENT_TYPE_GRAY_CODE  see cartesian_dda.pde, as the are not "inline"
 
-	return round( (distance*60000000.0) / (feedrate*(float)total_steps) );	
+template <class Axis> inline void cartesian_dda::dda_axis(bool can, long& counter, long increment, long& current, bool forward)
+{
+  if(!can)
+    return;
+  counter += increment;
+  if(counter > 0)
+  {
+    Axis::step();
+    real_move = true;
+    counter -= dda_total;
+    if(forward)
+      current++;
+    else
+      current--;
+  }
 }
 
+// The step pins have been high since dda_axis(); the drivers need them to
+// stay that way for STEP_PULSE_US.  The DDA's sums in between count too,
+// so this is at least that long.
 
-inline bool cartesian_dda::xCanStep(long current, long target, bool dir)
+inline void cartesian_dda::end_steps()
 {
-
-        // clear the hit bits
-        
-        endstop_hits &= (~X_LOW_HIT & ~X_HIGH_HIT);
-        
-//stop us if we're on target
-
-	if (target == current)
-		return false;
-        
-//stop us if we're home and still going lower
-
-#if ENDSTOPS_MIN_ENABLED == 1
-
-        // Set the low hit bit
-        
-        endstop_hits |= X_LOW_HIT;
-        
-#if X_ENDSTOP_INVERTING
-	if(!dir && !digitalRead(X_MIN_PIN) )
-        {
-                zeroHit.x = current;
-		return false;
-        }
-#else
-	if(!dir && digitalRead(X_MIN_PIN) )
-        {
-                zeroHit.x = current;
-		return false;
-        }
-#endif
-
-        // clear the low hit bit
-        
-        endstop_hits &= ~X_LOW_HIT;
-        
+#if STEP_PULSE_US > 0
+  _delay_us(STEP_PULSE_US);
 #endif
-        
-//stop us if we're at max and still going higher
-
-#if ENDSTOPS_MAX_ENABLED == 1
-
-        // Set the high hit bit
-        
-        endstop_hits |= X_HIGH_HIT;
-        
-#if X_ENDSTOP_INVERTING
-	if(dir && !digitalRead(X_MAX_PIN) )
-		return false;
-#else
-	if(!dir && digitalRead(X_MAX_PIN) )
-		return false;
-#endif
-
-        // Clear the high hit bit
-        
-        endstop_hits &= ~X_HIGH_HIT;
+  XAxis::end_step();
+  YAxis::end_step();
+  ZAxis::end_step();
+  EAxis::end_step();
+}
 
+//TODO implement running a makerbot DC extruder here? 
+#if MOVEMENT_TYPE == MOVEMENT_TYPE_UNMANAGED_DC
+#error TODO need to fully implement running a makerbot DC extruder from reprap firmware
 #endif
 
-
-// All OK - we can step
-  
-	return true;
+inline unsigned int cartesian_dda::calculate_feedrate_delay(unsigned int r)
+{  
+	// Calculate the timer count between steps at the fixed clk/8 prescaler
+	// by interpolating in the tables made by createSpeedLookupTable.py.
+	// This runs every step in the interrupt, so no divisions and no floats.
+	
+	unsigned int ticks;
+	
+	if(r >= SPEED_TABLE_FAST_RATE)
+	{
+		const unsigned short* entry = speed_lookuptable_fast[r >> 8];
+		ticks = pgm_read_word(entry) - (((r & 0xff)*pgm_read_word(entry + 1)) >> 8);
+	} else
+	{
+		const unsigned short* entry = speed_lookuptable_slow[r >> 3];
+		ticks = pgm_read_word(entry) - (((r & 0x07)*(unsigned long)pgm_read_word(entry + 1)) >> 3);
+	}
+	return ticks;
 }
 
-inline bool cartesian_dda::yCanStep(long current, long target, bool dir)
+inline unsigned long cartesian_dda::rate_change()
 {
-  
-        // clear the hit bits
-        
-        endstop_hits &= (~Y_LOW_HIT & ~Y_HIGH_HIT);
-        
-//stop us if we're on target
-
-	if (target == current)
-		return false;
-
-//stop us if we're home and still going lower
-
-#if ENDSTOPS_MIN_ENABLED == 1
-
-        // Set the low hit bit
-        
-        endstop_hits |= Y_LOW_HIT;
-        
-#if Y_ENDSTOP_INVERTING
-	if(!dir && !digitalRead(Y_MIN_PIN) )
-        {
-                zeroHit.y = current;
-		return false;
-        }
-#else
-	if(!dir && digitalRead(Y_MIN_PIN) )
-        {
-                zeroHit.y = current;
-		return false;
-        }
-#endif
-
-        // clear the low hit bit
-        
-        endstop_hits &= ~Y_LOW_HIT;
-        
-#endif
-
-//stop us if we're at max and still going higher
+	// Only the slow steps (see set_step_timer()) are longer than 16 bits,
+	// and they can afford a division to stop the product overflowing.
+	
+	if(timestep > 65535 && block->acceleration_rate > 0xffffffffUL/timestep)
+		return 0xffffffffUL;
+	return block->acceleration_rate*timestep;
+}
 
-#if ENDSTOPS_MAX_ENABLED == 1
 
-        // Set the high hit bit
-        
-        endstop_hits |= Y_HIGH_HIT;
-        
-#if Y_ENDSTOP_INVERTING
-	if(dir && !digitalRead(Y_MAX_PIN) )
-		return false;
-#else
-	if(!dir && digitalRead(Y_MAX_PIN) )
-		return false;
-#endif
+// Is an endstop triggered?  Boards without one have its pin set to -1
+// in pins.h, which is off the end of fastio.h's table; those never are.
 
-        // Clear the high hit bit
-        
-        endstop_hits &= ~Y_HIGH_HIT;
-        
-#endif
-
-// All OK - we can step
-  
-	return true;
+template <uint8_t pin, bool inverting> inline bool endstop_hit()
+{
+  if(pin >= digitalPinCount)
+    return false;
+  return fastDigitalRead(pin) != inverting;
 }
 
-inline bool cartesian_dda::zCanStep(long current, long target, bool dir)
+// Look at the endstops.  This is called by the pin change interrupts when
+// an endstop changes, or every step if we have to poll them.
+
+inline void cartesian_dda::read_endstops()
 {
+  byte e = 0;
   
-          // clear the hit bits
-        
-        endstop_hits &= (~Z_LOW_HIT & ~Z_HIGH_HIT);
-        
-//stop us if we're on target
-
-	if (target == current)
-		return false;
-
-//stop us if we're home and still going lower
-
 #if ENDSTOPS_MIN_ENABLED == 1
-
-        // Set the low hit bit
-        
-        endstop_hits |= Z_LOW_HIT;
-        
-#if Z_ENDSTOP_INVERTING
-	if(!dir && !digitalRead(Z_MIN_PIN) )
-        {
-                zeroHit.z = current;
-		return false;
-        }
-#else
-	if(!dir && digitalRead(Z_MIN_PIN) )
-        {
-                zeroHit.z = current;
-		return false;
-        }
+  if(endstop_hit<X_MIN_PIN, X_ENDSTOP_INVERTING>())
+    e |= X_LOW_HIT;
+  if(endstop_hit<Y_MIN_PIN, Y_ENDSTOP_INVERTING>())
+    e |= Y_LOW_HIT;
+  if(endstop_hit<Z_MIN_PIN, Z_ENDSTOP_INVERTING>())
+    e |= Z_LOW_HIT;
 #endif
-
-        // clear the low hit bit
-        
-        endstop_hits &= ~Z_LOW_HIT;
-        
-#endif
-
-//stop us if we're at max and still going higher
-
 #if ENDSTOPS_MAX_ENABLED == 1
-
-        // Set the high hit bit
-        
-        endstop_hits |= Z_HIGH_HIT;
-        
-#if Z_ENDSTOP_INVERTING
-	if(dir && !digitalRead(Z_MAX_PIN) )
-		return false;
-#else
-	if(!dir && digitalRead(Z_MAX_PIN) )
-		return false;
+  if(endstop_hit<X_MAX_PIN, X_ENDSTOP_INVERTING>())
+    e |= X_HIGH_HIT;
+  if(endstop_hit<Y_MAX_PIN, Y_ENDSTOP_INVERTING>())
+    e |= Y_HIGH_HIT;
+  if(endstop_hit<Z_MAX_PIN, Z_ENDSTOP_INVERTING>())
+    e |= Z_HIGH_HIT;
 #endif
 
-        // Clear the high hit bit
-        
-        endstop_hits &= ~Z_HIGH_HIT;
-        
-#endif
-
-// All OK - we can step
-  
-	return true;
-}
-
-
-inline bool cartesian_dda::eCanStep(long current, long target, bool dir)
-{
-//stop us if we're on target
-
-	return !(target == current);
-}
-
-inline bool cartesian_dda::fCanStep(long current, long target, bool dir)
-{
-//stop us if we're on target
-
-	return !(target == current);
+  // Note where we were the moment we got home
+  
+  byte hit = e & ~endstops;
+  if(hit & X_LOW_HIT)
+    zeroHit.x = current_steps.x;
+  if(hit & Y_LOW_HIT)
+    zeroHit.y = current_steps.y;
+  if(hit & Z_LOW_HIT)
+    zeroHit.z = current_steps.z;
+    
+  endstops = e;
 }
 
 
@@ -10,7 +10,8 @@
 cartesian_dda::cartesian_dda()
 {
         live = false;
-        nullmove = false;
+        dwelling = false;
+        block = 0;
         
 // Default is going forward
   
@@ -18,15 +19,20 @@ cartesian_dda::cartesian_dda()
         y_direction = true;
         z_direction = true;
         e_direction = true;
-        f_direction = true;
         
 // Default to the origin and not going anywhere
   
-	target_position.x = 0.0;
-	target_position.y = 0.0;
-	target_position.z = 0.0;
-	target_position.e = 0.0;
-    target_position.f = SLOW_XY_FEEDRATE;
+        current_steps.x = 0;
+        current_steps.y = 0;
+        current_steps.z = 0;
+        current_steps.e = 0;
+        current_steps.f = 0;
+        target_steps = current_steps;
+        
+        last_nominal_feedrate = SLOW_XY_FEEDRATE;
+        last_min_feedrate = SLOW_XY_FEEDRATE;
+        step_loops = 1;
+        smoothing = 0;
 
 // Set up the pin directions
   
@@ -70,6 +76,14 @@ cartesian_dda::cartesian_dda()
 	pinMode(Y_MAX_PIN, INPUT);
 	pinMode(Z_MAX_PIN, INPUT);
 #endif
+
+        endstops = 0;
+        stop_mask = 0;
+#if ENDSTOP_INTERRUPTS
+        poll_endstops = !endstop_interrupts();
+#else
+        poll_endstops = true;
+#endif
 	
         // Default units are mm
         
@@ -92,109 +106,406 @@ void cartesian_dda::set_units()
       units.x = X_STEPS_PER_MM;
       units.y = Y_STEPS_PER_MM;
       units.z = Z_STEPS_PER_MM;
-      units.e = ex[extruder_in_use] ? ex[extruder_in_use]->stepsPerMM() : E0_STEPS_PER_MM;
+      units.e = ex[extruder_queued] ? ex[extruder_queued]->stepsPerMM() : E0_STEPS_PER_MM;
       units.f = 1.0;
+      nm_to_units = 0.000001;
     } else
     {
       units.x = X_STEPS_PER_INCH;
       units.y = Y_STEPS_PER_INCH;
       units.z = Z_STEPS_PER_INCH;
-      units.e = (ex[extruder_in_use] ? ex[extruder_in_use]->stepsPerMM() : E0_STEPS_PER_MM) * INCHES_TO_MM;
+      units.e = (ex[extruder_queued] ? ex[extruder_queued]->stepsPerMM() : E0_STEPS_PER_MM) * INCHES_TO_MM;
       units.f = 1.0;  
+      nm_to_units = 0.000001/INCHES_TO_MM;
     }
+    
+    // The planner works out distances in integer nanometres.  That's good
+    // for moves up to two metres; set_target() copes with longer extrudes.
+    
+    step_length.x = round(1000000.0/X_STEPS_PER_MM);
+    step_length.y = round(1000000.0/Y_STEPS_PER_MM);
+    step_length.z = round(1000000.0/Z_STEPS_PER_MM);
+    step_length.e = round(1000000.0/(ex[extruder_queued] ? ex[extruder_queued]->stepsPerMM() : E0_STEPS_PER_MM));
+    step_length.f = 0;
+    step_limit.x = LONG_MAX/step_length.x;
+    step_limit.y = LONG_MAX/step_length.y;
+    step_limit.z = LONG_MAX/step_length.z;
+    step_limit.e = LONG_MAX/step_length.e;
+    step_limit.f = LONG_MAX;
+    queued_valid = false;
 }
 
 
-void cartesian_dda::set_target(const FloatPoint& p)
+#if ENDSTOP_INTERRUPTS
+
+// Ask for a pin change interrupt on each endstop (see read_endstops()).
+// If any of them hasn't got one we just read them all every step.
+
+bool cartesian_dda::endstop_interrupts()
 {
-        target_position = p;
-        nullmove = false;
-        
-	//figure our deltas.
+  bool ok = true;
+#if ENDSTOPS_MIN_ENABLED == 1
+  ok = pinChangeInterrupt(X_MIN_PIN) && ok;
+  ok = pinChangeInterrupt(Y_MIN_PIN) && ok;
+  ok = pinChangeInterrupt(Z_MIN_PIN) && ok;
+#endif
+#if ENDSTOPS_MAX_ENABLED == 1
+  ok = pinChangeInterrupt(X_MAX_PIN) && ok;
+  ok = pinChangeInterrupt(Y_MAX_PIN) && ok;
+  ok = pinChangeInterrupt(Z_MAX_PIN) && ok;
+#endif
+  return ok;
+}
+
+#endif
 
-        delta_position = fabsv(target_position - where_i_am);
+void cartesian_dda::set_target(const FloatPoint& p, MoveBlock& b, bool queued, float buffered)
+{
+        // Work out the steps to take.  Unless the position has been changed
+        // behind our back (G92, homing...) we start where the last move queued ended.
+        
+        LongPoint steps = to_steps(units, p);
+        if(!queued_valid || where_i_am.x != queued_position.x || where_i_am.y != queued_position.y ||
+              where_i_am.z != queued_position.z || where_i_am.e != queued_position.e)
+          queued_steps = to_steps(units, where_i_am);
+	LongPoint delta_steps = steps - queued_steps;
+        queued_position = p;
+        queued_steps = steps;
+        queued_valid = true;
         
-        // The feedrate values refer to distance in (X, Y, Z) space, so ignore e and f
-        // values unless they're the only thing there.
-
-        FloatPoint squares = delta_position*delta_position;
-        distance = squares.x + squares.y + squares.z;
-        // If we are 0, only thing changing is e
-        if(distance < SMALL_DISTANCE2)
-          distance = squares.e;
-        // If we are still 0, only thing changing is f
-        if(distance < SMALL_DISTANCE2)
-          distance = squares.f;
-        distance = sqrt(distance);          
-                                                                                   			
-	//set our steps current, target, and delta
-
-        current_steps = to_steps(units, where_i_am);
-	target_steps = to_steps(units, target_position);
-	delta_steps = absv(target_steps - current_steps);
+	//set our steps and directions
+
+        b.directions = 0;
+        if(delta_steps.x >= 0)
+          b.directions |= X_PLUS;
+        if(delta_steps.y >= 0)
+          b.directions |= Y_PLUS;
+        if(delta_steps.z >= 0)
+          b.directions |= Z_PLUS;
+        if(delta_steps.e >= 0)
+          b.directions |= E_PLUS;
+          
+        LongPoint delta_nm = clamped_product(delta_steps, step_length, step_limit);
+        delta_steps = absv(delta_steps);
+        b.x_steps = delta_steps.x;
+        b.y_steps = delta_steps.y;
+        b.z_steps = delta_steps.z;
+        b.e_steps = delta_steps.e;
 
 	// find the dominant axis.
-        // NB we ignore the f values here, as it takes no time to take a step in time :-)
 
-        total_steps = max(delta_steps.x, delta_steps.y);
-        total_steps = max(total_steps, delta_steps.z);
-        total_steps = max(total_steps, delta_steps.e);
-  
-        // If we're not going anywhere, flag the fact
+        b.total_steps = max(delta_steps.x, delta_steps.y);
+        b.total_steps = max(b.total_steps, delta_steps.z);
+        b.total_steps = max(b.total_steps, delta_steps.e);
         
-        if(total_steps == 0)
+        // If we're not going anywhere, there's nothing more to do
+        
+        if(b.total_steps == 0)
         {
-          nullmove = true;
           where_i_am = p;
           return;
         }    
-
-#if ACCELERATION != ACCELERATION_ON
-        current_steps.f = target_steps.f;
+        
+        // The feedrate values refer to distance in (X, Y, Z) space, so ignore e 
+        // unless it's the only thing there.  For tiny moves use whichever is bigger.
+        // This is all in integer nanometres.
+
+        unsigned long xyz = lengthv(delta_nm.x, delta_nm.y, delta_nm.z);
+        unsigned long length = xyz;
+        if(length < SMALL_DISTANCE_NM)
+          length = labs(delta_nm.e);
+        if(length < SMALL_DISTANCE_NM)
+          length = max(xyz, (unsigned long)labs(delta_nm.e));
+        float distance = length*nm_to_units;
+        
+        // An extrude of more than two metres doesn't fit in nanometres, so
+        // the length has been clamped; go by the steps instead.
+        
+        if(length == (unsigned long)LONG_MAX && labs(delta_nm.e) == LONG_MAX)
+          distance = delta_steps.e/units.e;
+        
+        b.distance = distance;
+        
+        // F0, or no F at all since a reset (where_i_am starts at zero), would
+        // divide by zero; go at the slow speed for the axes moving instead.
+        
+        bool z_only = delta_steps.z && !delta_steps.x && !delta_steps.y;
+        b.nominal_feedrate = p.f;
+        if(b.nominal_feedrate < MIN_FEEDRATE)
+          b.nominal_feedrate = max(z_only ? SLOW_Z_FEEDRATE : SLOW_XY_FEEDRATE, MIN_FEEDRATE);
+        b.time = 60000.0*distance/b.nominal_feedrate;
+        
+        // Is the queue getting short?  Slow down in proportion, so there's
+        // more time for the rest of the moves to arrive before it runs dry.
+        
+#if SLOWDOWN_QUEUE_TIME > 0
+        if(queued && buffered + b.time < SLOWDOWN_QUEUE_TIME)
+        {
+          b.nominal_feedrate *= (buffered + b.time)/SLOWDOWN_QUEUE_TIME;
+          b.time = 60000.0*distance/b.nominal_feedrate;
+          queue_slowdowns++;
+        }
 #endif
-
-        delta_steps.f = abs(target_steps.f - current_steps.f);
         
-        // Rescale the feedrate so it doesn't take lots of steps to do
+#if ACCELERATION == ACCELERATION_ON
+        if(z_only)
+          b.min_feedrate = SLOW_Z_FEEDRATE;
+        else
+          b.min_feedrate = SLOW_XY_FEEDRATE;
+        if(b.min_feedrate > b.nominal_feedrate)
+          b.min_feedrate = b.nominal_feedrate;
+#else
+        b.min_feedrate = b.nominal_feedrate;
+#endif
+        b.max_entry_feedrate = b.min_feedrate;
+        
+#if ACCELERATION == ACCELERATION_ON
+        // Accelerate along the move as hard as the slowest axis will let us
+        
+        b.acceleration = X_ACCELERATION + Y_ACCELERATION + Z_ACCELERATION + E_ACCELERATION;
+        if(delta_steps.x)
+          b.acceleration = min(b.acceleration, X_ACCELERATION*length/labs(delta_nm.x));
+        if(delta_steps.y)
+          b.acceleration = min(b.acceleration, Y_ACCELERATION*length/labs(delta_nm.y));
+        if(delta_steps.z)
+          b.acceleration = min(b.acceleration, Z_ACCELERATION*length/labs(delta_nm.z));
+        if(delta_steps.e)
+          b.acceleration = min(b.acceleration, E_ACCELERATION*length/labs(delta_nm.e));
+          
+        // ...and turn that into steps per second per timer tick along the longest axis
+          
+        float accel_steps = b.acceleration*b.total_steps/distance;
+        b.acceleration_rate = constrain(round(accel_steps*65536.0/TIMER_TICKS_PER_SECOND), 1, 65535);
+#else
+        b.acceleration = 0;
+        b.acceleration_rate = 0;
+#endif
+        
+        // The direction we're going in, for the look-ahead planner.  Like the
+        // distance, this is in (X, Y, Z) unless E is all there is.
         
-        t_scale = 1;
-        if(delta_steps.f > total_steps)
+        FloatPoint unit_vector;
+        float inverse = 1.0/length;
+        if(xyz < SMALL_DISTANCE_NM)
+          unit_vector.e = delta_nm.e*inverse;
+        else
         {
-            t_scale = delta_steps.f/total_steps;
-            if(t_scale >= 3)
-            {
-              target_steps.f = target_steps.f/t_scale;
-              current_steps.f = current_steps.f/t_scale;
-              delta_steps.f = abs(target_steps.f - current_steps.f);
-              if(delta_steps.f > total_steps)
-                total_steps =  delta_steps.f;
-            } else
-            {
-              t_scale = 1;
-              total_steps =  delta_steps.f;
-            }
-        } 
-        	
-	//what is our direction?
+          unit_vector.x = delta_nm.x*inverse;
+          unit_vector.y = delta_nm.y*inverse;
+          unit_vector.z = delta_nm.z*inverse;
+        }
         
-	x_direction = (target_position.x >= where_i_am.x);
-	y_direction = (target_position.y >= where_i_am.y);
-	z_direction = (target_position.z >= where_i_am.z);
-        e_direction = (target_position.e >= where_i_am.e);
-	f_direction = (target_position.f >= where_i_am.f);
+#if ACCELERATION == ACCELERATION_ON
+        if(queued)
+          set_junction(b, unit_vector);
+#endif
 
+        last_unit_vector = unit_vector;
+        last_nominal_feedrate = b.nominal_feedrate;
+        last_min_feedrate = b.min_feedrate;
 
-	dda_counter.x = -total_steps/2;
-	dda_counter.y = dda_counter.x;
-	dda_counter.z = dda_counter.x;
-        dda_counter.e = dda_counter.x;
-        dda_counter.f = dda_counter.x;
+        // Until the planner says otherwise, start and stop dead
+        
+        plan_profile(b, b.min_feedrate, b.min_feedrate, b.profile);
   
         where_i_am = p;
-        
-        return;        
 }
 
+// G92 and friends.  The moves queued so far are worked out in the old
+// coordinates, so the interrupt mustn't change over till it gets to b.
+
+void cartesian_dda::set_position(const FloatPoint& p, MoveBlock& b)
+{
+        queued_position = p;
+        queued_steps = to_steps(units, p);
+        queued_valid = true;
+        b.x_steps = queued_steps.x;
+        b.y_steps = queued_steps.y;
+        b.z_steps = queued_steps.z;
+        b.e_steps = queued_steps.e;
+        where_i_am = p;
+}
+
+#if ACCELERATION == ACCELERATION_ON
+
+// Twice a block's acceleration in mm/minute/minute
+
+#define ACCELERATION_X2(b) (2.0*60.0*60.0*(b).acceleration)
+
+// How fast can we go round the corner from the previous move queued into
+// this one?  This treats the corner as an arc JUNCTION_DEVIATION away from
+// the corner point and sets the speed to give the block's acceleration round it.
+
+void cartesian_dda::set_junction(MoveBlock& b, const FloatPoint& unit_vector)
+{
+  if(b.max_entry_feedrate > last_min_feedrate)
+    b.max_entry_feedrate = last_min_feedrate;
+    
+  float limit = min(b.nominal_feedrate, last_nominal_feedrate);
+  
+  // -cos of the angle between the two directions
+
+  float cos_theta = -(unit_vector.x*last_unit_vector.x + unit_vector.y*last_unit_vector.y +
+          unit_vector.z*last_unit_vector.z + unit_vector.e*last_unit_vector.e);
+  
+  // Straight back the way we came?
+  
+  if(cos_theta > 0.999)
+    return;
+    
+  // Straight on?
+  
+  if(cos_theta < -0.999)
+  {
+    b.max_entry_feedrate = limit;
+    return;
+  }
+  
+  float sin_theta_2 = sqrt(0.5*(1.0 - cos_theta));
+  float v = 60.0*sqrt(b.acceleration*JUNCTION_DEVIATION*sin_theta_2/(1.0 - sin_theta_2));
+  if(v > limit)
+    v = limit;
+  if(v > b.max_entry_feedrate)
+    b.max_entry_feedrate = v;
+}
+
+// The fastest we can enter and still slow down to exit by the end
+
+float cartesian_dda::entry_limit(const MoveBlock& b, float exit)
+{
+  float v = sqrt(exit*exit + ACCELERATION_X2(b)*b.distance);
+  return min(v, b.max_entry_feedrate);
+}
+
+// The fastest we can leave having come in at entry
+
+float cartesian_dda::exit_limit(const MoveBlock& b, float entry)
+{
+  float v = sqrt(entry*entry + ACCELERATION_X2(b)*b.distance);
+  return min(v, b.nominal_feedrate);
+}
+
+#else
+
+float cartesian_dda::entry_limit(const MoveBlock& b, float exit)
+{
+  return b.max_entry_feedrate;
+}
+
+float cartesian_dda::exit_limit(const MoveBlock& b, float entry)
+{
+  return b.nominal_feedrate;
+}
+
+#endif
+
+// The fastest step rate the interrupt is asked to go at.  Rates are kept
+// with 16 fractional bits in an unsigned long, so this is the most there is room for.
+
+#define MAX_STEP_RATE 65535
+
+// Work out the speed up - cruise - slow down profile for a block given
+// where it starts and finishes, and turn it into step rates for the interrupt.
+
+void cartesian_dda::plan_profile(const MoveBlock& b, float entry, float exit, SpeedProfile& p)
+{
+  float peak = b.nominal_feedrate;
+  long up = 0;
+  long down = 0;
+  
+#if ACCELERATION == ACCELERATION_ON
+  float ramp_up = (peak*peak - entry*entry)/ACCELERATION_X2(b);
+  float ramp_down = (peak*peak - exit*exit)/ACCELERATION_X2(b);
+  
+  // If we can't get up to speed before we have to slow down, meet in the middle
+  
+  if(ramp_up + ramp_down > b.distance)
+  {
+    peak = sqrt(0.5*(ACCELERATION_X2(b)*b.distance + entry*entry + exit*exit));
+    ramp_up = (peak*peak - entry*entry)/ACCELERATION_X2(b);
+    ramp_down = b.distance - ramp_up;
+  }
+  if(ramp_up > 0)
+    up = round(b.total_steps*ramp_up/b.distance);
+  if(ramp_down > 0)
+    down = round(b.total_steps*ramp_down/b.distance);
+  if(up > b.total_steps)
+    up = b.total_steps;
+  if(up + down > b.total_steps)
+    down = b.total_steps - up;
+#endif
+
+  // mm/minute to steps/second along the longest axis
+  
+  float to_rate = (float)b.total_steps/(60.0*b.distance);
+  
+  p.initial_rate = constrain(round(entry*to_rate), 1, MAX_STEP_RATE);
+  p.final_rate = constrain(round(exit*to_rate), 1, MAX_STEP_RATE);
+  p.peak_rate = constrain(round(peak*to_rate), 1, MAX_STEP_RATE);
+  if(p.peak_rate < p.initial_rate)
+    p.peak_rate = p.initial_rate;
+  if(p.peak_rate < p.final_rate)
+    p.peak_rate = p.final_rate;
+    
+  p.accelerate_until = up;
+  p.decelerate_after = b.total_steps - down;
+}
+
+
+// Set the timer for the next step from the current rate
+
+inline void cartesian_dda::set_step_timer()
+{
+	unsigned int r = rate >> 16;
+	
+	// Too fast to take one step per interrupt?  Take two or four at a time
+	// with the interrupts that much further apart.
+	
+	step_loops = 1;
+	if(QUAD_STEP_RATE && r > QUAD_STEP_RATE)
+	{
+		r >>= 2;
+		step_loops = 4;
+	} else if(DOUBLE_STEP_RATE && r > DOUBLE_STEP_RATE)
+	{
+		r >>= 1;
+		step_loops = 2;
+	}
+	
+	// Too slow for the shorter axes to step smoothly?  Run the interrupt two,
+	// four or eight times a step.  The counters go up by less each time, so
+	// they all still step at the same rates, but in between the longest axis'
+	// steps rather than with them.
+	
+	byte s = 0;
+	while(s < MAX_SMOOTHING && r < SMOOTH_STEP_RATE)
+	{
+		r <<= 1;
+		s++;
+	}
+	if(s != smoothing)
+	{
+		smoothing = s;
+		s = MAX_SMOOTHING - s;
+		dda_increment.x = block->x_steps << s;
+		dda_increment.y = block->y_steps << s;
+		dda_increment.z = block->z_steps << s;
+		dda_increment.e = block->e_steps << s;
+		if(smooth_count > (1 << smoothing))
+			smooth_count = 1 << smoothing;
+	}
+
+	// Very slow moves (the odd slow extrude) are off the end of the table;
+	// they have plenty of time between steps for a division.
+	
+	if(r < SPEED_TABLE_MIN_RATE)
+		timestep = (unsigned long)TIMER_TICKS_PER_SECOND/r;
+	else
+		timestep = calculate_feedrate_delay(r);
+	setTimerTicks(timestep);
+}
+
+
 // This function is called by an interrupt.  Consequently interrupts are off for the duration
 // of its execution.  Consequently it has to be as optimised and as fast as possible.
 
@@ -202,184 +513,181 @@ void cartesian_dda::dda_step()
 {  
   if(!live)
    return;
+   
+  // Pausing?  This is the interrupt at the end of it
+  
+  if(dwelling)
+  {
+    dwelling = false;
+    live = false;
+    return;
+  }
 
-  do
+  real_move = false;
+  
+  // Have we hit anything we're heading for?
+  
+  if(poll_endstops)
+    read_endstops();
+  byte stopped = endstops & stop_mask;
+  endstop_hits |= stopped;
+  
+  // At high step rates take step_loops steps each time round (see set_step_timer())
+  
+  live = can_step(stopped);
+  for(byte s = 0; live && s < step_loops; s++)
   {
-                x_can_step = xCanStep(current_steps.x, target_steps.x, x_direction);
-		y_can_step = yCanStep(current_steps.y, target_steps.y, y_direction);
-                z_can_step = zCanStep(current_steps.z, target_steps.z, z_direction);
-                e_can_step = eCanStep(current_steps.e, target_steps.e, e_direction);
-                f_can_step = fCanStep(current_steps.f, target_steps.f, f_direction);
+                dda_axis<XAxis>(x_can_step, dda_counter.x, dda_increment.x, current_steps.x, x_direction);
+                dda_axis<YAxis>(y_can_step, dda_counter.y, dda_increment.y, current_steps.y, y_direction);
+                dda_axis<ZAxis>(z_can_step, dda_counter.z, dda_increment.z, current_steps.z, z_direction);
+                dda_axis<EAxis>(e_can_step, dda_counter.e, dda_increment.e, current_steps.e, e_direction);
+		
+                if(!--smooth_count)
+                {
+                  step_count++;
+                  smooth_count = 1 << smoothing;
+                }
                 
-                real_move = false;
+                // Check after stepping rather than next time, so the interrupt
+                // that takes the last step can go straight on to the next block
                 
-		if (x_can_step)
-		{
-			dda_counter.x += delta_steps.x;
-			
-			if (dda_counter.x > 0)
-			{
-				do_x_step();
-                                real_move = true;
-				dda_counter.x -= total_steps;
-				
-				if (x_direction)
-					current_steps.x++;
-				else
-					current_steps.x--;
-			}
-		}
-
-		if (y_can_step)
-		{
-			dda_counter.y += delta_steps.y;
-			
-			if (dda_counter.y > 0)
-			{
-				do_y_step();
-                                real_move = true;
-				dda_counter.y -= total_steps;
-
-				if (y_direction)
-					current_steps.y++;
-				else
-					current_steps.y--;
-			}
-		}
-		
-		if (z_can_step)
-		{
-			dda_counter.z += delta_steps.z;
-			
-			if (dda_counter.z > 0)
-			{
-				do_z_step();
-                                real_move = true;
-				dda_counter.z -= total_steps;
-				
-				if (z_direction)
-					current_steps.z++;
-				else
-					current_steps.z--;
-			}
-		}
-
-		if (e_can_step)
-		{
-			dda_counter.e += delta_steps.e;
-			
-			if (dda_counter.e > 0)
-			{
-                                
-				do_e_step();
-                                real_move = true;
-				dda_counter.e -= total_steps;
-				
-				if (e_direction)
-					current_steps.e++;
-				else
-					current_steps.e--;
-			}
-		}
+                live = can_step(stopped);
+                
+                if(real_move)
+                  end_steps();
+  }
 		
-		if (f_can_step)
-		{
-			dda_counter.f += delta_steps.f;
-			
-			if (dda_counter.f > 0)
-			{
-				dda_counter.f -= total_steps;
-				if (f_direction)
-					current_steps.f++;
-				else
-					current_steps.f--;
-                                feed_change = true;
-			} else
-                                feed_change = false;
-		}
+      // Follow the speed profile the planner gave us.  The longest axis steps
+      // every time round the loop, so step_count is how far along the move we are.
+      // The rate changes by the acceleration times the time since the last interrupt.
+      
+                if(step_count <= block->profile.accelerate_until)
+                {
+                        unsigned long peak = (unsigned long)block->profile.peak_rate << 16;
+                        unsigned long dv = rate_change();
+                        if(rate < peak && peak - rate > dv)
+                                rate += dv;
+                        else
+                                rate = peak;
+                        feed_change = true;
+                } else if(step_count > block->profile.decelerate_after)
+                {
+                        unsigned long final = (unsigned long)block->profile.final_rate << 16;
+                        unsigned long dv = rate_change();
+                        if(rate > final && rate - final > dv)
+                                rate -= dv;
+                        else
+                                rate = final;
+                        feed_change = true;
+                } else if(rate != (unsigned long)block->profile.peak_rate << 16)
+                {
+                        // Cruise at exactly the planned speed, even if we didn't quite get there
+                        
+                        rate = (unsigned long)block->profile.peak_rate << 16;
+                        feed_change = true;
+                }
 
 				
       // wait for next step.
-      // Use milli- or micro-seconds, as appropriate
-      // If the only thing that changed was f keep looping
   
-                if(real_move && feed_change)
+                if(live && real_move && feed_change)
                 {
-                  timestep = t_scale*current_steps.f;
-                  timestep = calculate_feedrate_delay((float) timestep);
-                  setTimer(timestep);
+                  set_step_timer();
+                  feed_change = false;
                 }
-                feed_change = false;
                 
-  } while (!real_move && f_can_step);
+  // A homing move has to finish on its endstops; if not, tell checkHoming()
   
-  live = (x_can_step || y_can_step || z_can_step  || e_can_step || f_can_step);
+  if(!live && block->must_hit)
+  {
+    if(poll_endstops)
+      read_endstops();
+    endstop_hits |= endstops & stop_mask;
+    homing_faults |= block->must_hit & ~endstop_hits;
+  }
+}
 
-// Wrap up at the end of a line
+// Wrap up when there's nothing left in the queue to go on to
 
-  if(!live)
-  {
-      disable_steppers();
-      setTimer(DEFAULT_TICK);
-  }    
-  
+void cartesian_dda::dda_stop()
+{
+  setTimerTicks(DEFAULT_TIMER_TICKS);
 }
 
 
-// Run the DDA
+// Run the DDA on a block from the queue
 
-void cartesian_dda::dda_start()
+void cartesian_dda::dda_start(MoveBlock* b)
 {    
-  // Set up the DDA
+  block = b;
   
-  if(nullmove)
+  // A G4 pause has nothing to step, just time to count off
+  
+  if(b->command == DWELL)
+  {
+    setTimerTicks((unsigned long)b->command_value*(unsigned long)(TIMER_TICKS_PER_SECOND/1000.0));
+    dwelling = true;
+    live = true;
     return;
+  }
+  dwelling = false;
+  
+  // Set up the DDA
+  
+  x_direction = b->directions & X_PLUS;
+  y_direction = b->directions & Y_PLUS;
+  z_direction = b->directions & Z_PLUS;
+  e_direction = b->directions & E_PLUS;
+  
+  target_steps.x = current_steps.x + (x_direction ? b->x_steps : -b->x_steps);
+  target_steps.y = current_steps.y + (y_direction ? b->y_steps : -b->y_steps);
+  target_steps.z = current_steps.z + (z_direction ? b->z_steps : -b->z_steps);
+  target_steps.e = current_steps.e + (e_direction ? b->e_steps : -b->e_steps);
+  
+  // The counters are scaled up by 2^MAX_SMOOTHING, so set_step_timer()
+  // can change how often they're added to in the middle of the move.
+  
+  dda_total = b->total_steps << MAX_SMOOTHING;
+  dda_counter.x = -dda_total/2;
+  dda_counter.y = dda_counter.x;
+  dda_counter.z = dda_counter.x;
+  dda_counter.e = dda_counter.x;
+  
+  // The endstops that stop us are the ones we're moving towards
+  
+  stop_mask = 0;
+  if(b->x_steps)
+    stop_mask |= x_direction ? X_HIGH_HIT : X_LOW_HIT;
+  if(b->y_steps)
+    stop_mask |= y_direction ? Y_HIGH_HIT : Y_LOW_HIT;
+  if(b->z_steps)
+    stop_mask |= z_direction ? Z_HIGH_HIT : Z_LOW_HIT;
+  endstop_hits = 0;
+  read_endstops();
+  
+  step_count = 0;
+  smoothing = 0xff;        // Make set_step_timer() work out the increments
+  smooth_count = 1;
+  rate = (unsigned long)b->profile.initial_rate << 16;
 
 //set our direction pins as well
    
-  byte d = 1;
-  	
-#if INVERT_X_DIR == 1
-  if(x_direction)
-    d = 0;
-#else
-  if(!x_direction)
-    d = 0;	
-#endif
-  digitalWrite(X_DIR_PIN, d);
-        
-  d = 1;
-    
-#if INVERT_Y_DIR == 1
-  if(y_direction)
-    d = 0;
-#else
-  if(!y_direction)
-    d = 0;	
-#endif
-  digitalWrite(Y_DIR_PIN, d);
-        
-  d = 1;
-    
-#if INVERT_Z_DIR == 1
-  if(z_direction)
-     d = 0;
-#else
-  if(!z_direction)
-     d = 0;	
-#endif
-  digitalWrite(Z_DIR_PIN, d);
-
-
-  ex[extruder_in_use]->setDirection(e_direction);
+  XAxis::set_direction(x_direction);
+  YAxis::set_direction(y_direction);
+  ZAxis::set_direction(z_direction);
+  EAxis::set_direction(e_direction);
   
 //turn on steppers to start moving =)
     
   enable_steppers();
 
-  setTimer(DEFAULT_TICK);
+  // The first step is one step time away at the entry speed the planner
+  // gave us.  When this is called from the interrupt that took the last step
+  // of the block before, that's the same as if the two were one move.
+  
+  set_step_timer();
   live = true;
-  feed_change = true; // force timer setting on the first call to dda_step()
+  feed_change = false;
 }
 
 
@@ -388,21 +696,22 @@ void cartesian_dda::dda_start()
 void cartesian_dda::enable_steppers()
 {
 #ifdef X_ENABLE_PIN 
-  if(delta_steps.x)
-    digitalWrite(X_ENABLE_PIN, ENABLE_ON);
+  if(block->x_steps)
+    fastDigitalWrite(X_ENABLE_PIN, ENABLE_ON);
 #endif
 #ifdef Y_ENABLE_PIN
-  if(delta_steps.y)    
-    digitalWrite(Y_ENABLE_PIN, ENABLE_ON);
+  if(block->y_steps)    
+    fastDigitalWrite(Y_ENABLE_PIN, ENABLE_ON);
     #endif
 #ifdef Z_ENABLE_PIN
-  if(delta_steps.z)
-    digitalWrite(Z_ENABLE_PIN, ENABLE_ON);
+  if(block->z_steps)
+    fastDigitalWrite(Z_ENABLE_PIN, ENABLE_ON);
     #endif
 #ifdef E_ENABLE_PIN
-  if(delta_steps.e)
+  if(block->e_steps)
     ex[extruder_in_use]->enableStep();
 #endif  
+  steppers_on = true;
 }
 
 
@@ -411,23 +720,22 @@ void cartesian_dda::disable_steppers()
 {
 	//disable our steppers
 #if DISABLE_X
-	digitalWrite(X_ENABLE_PIN, !ENABLE_ON);
+	fastDigitalWrite(X_ENABLE_PIN, !ENABLE_ON);
 #endif
 #if DISABLE_Y
-	digitalWrite(Y_ENABLE_PIN, !ENABLE_ON);
+	fastDigitalWrite(Y_ENABLE_PIN, !ENABLE_ON);
 #endif
 #if DISABLE_Z
-        digitalWrite(Z_ENABLE_PIN, !ENABLE_ON);
+        fastDigitalWrite(Z_ENABLE_PIN, !ENABLE_ON);
 #endif
 
         ex[extruder_in_use]->disableStep();
-        
+        steppers_on = false;
 }
 
 void cartesian_dda::shutdown()
 {
   live = false;
-  nullmove = false;
   disable_steppers();
 }
 
@@ -446,8 +754,8 @@ if INVERT_X_DIR == 1
           int X1 = gray_code & 1; //lower order bit
           int X2 = gray_code & 2; //higher order bit
           // write the quadrature/grey code to the two pins commonly referrred to as STEP and DIRECTION ( despite them not actually being that in this case)
-          digitalWrite(X_STEP_PIN, X1);
-          digitalWrite(X_DIR_PIN, X2);
+          fastDigitalWrite(X_STEP_PIN, X1);
+          fastDigitalWrite(X_DIR_PIN, X2);
           delayMicrosecondsInterruptible(5);
 }
 void cartesian_dda::do_y_step()
@@ -463,8 +771,8 @@ void cartesian_dda::do_y_step()
           int Y1 = gray_code & 1; //lower order bit
           int Y2 = gray_code & 2; //higher order bit
          // write the quadrature/grey code to the two pins commonly referrred to as STEP and DIRECTION ( despite them not actually being that in this case)
-          digitalWrite(Y_STEP_PIN, Y1);
-          digitalWrite(Y_DIR_PIN, Y2);
+          fastDigitalWrite(Y_STEP_PIN, Y1);
+          fastDigitalWrite(Y_DIR_PIN, Y2);
           delayMicrosecondsInterruptible(5);
 }
 void cartesian_dda::do_z_step()
@@ -480,8 +788,8 @@ void cartesian_dda::do_z_step()
           int Z1 = gray_code & 1; //lower order bit
           int Z2 = gray_code & 2; //higher order bit
          // write the quadrature/grey code to the two pins commonly referrred to as STEP and DIRECTION ( despite them not actually being that in this case)
-          digitalWrite(Z_STEP_PIN, Z1);
-          digitalWrite(Z_DIR_PIN, Z2);
+          fastDigitalWrite(Z_STEP_PIN, Z1);
+          fastDigitalWrite(Z_DIR_PIN, Z2);
           delayMicrosecondsInterruptible(5);
 }
 #endif //MOVEMENT_TYPE == MOVEMENT_TYPE_GRAY_CODE
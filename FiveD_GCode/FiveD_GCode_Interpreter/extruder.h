@@ -45,6 +45,7 @@ public:
    
 //   void interrupt();
    void sStep();
+   void sStepEnd();
 
    void enableStep();
    void disableStep();
@@ -83,6 +84,12 @@ private:
 // The pins we control
     byte motor_dir_pin, motor_speed_pin, heater_pin, fan_pin, temp_pin, valve_dir_pin, valve_en_pin, step_en_pin;
     
+// Where the step and step enable pins live, for fast stepping
+// (en_port is 0 if there's no step enable pin)
+    volatile uint8_t* step_port;
+    volatile uint8_t* en_port;
+    uint8_t step_mask, en_mask;
+    
      byte wait_till_hot();
      //byte wait_till_cool();
      void temperatureError(); 
@@ -106,11 +113,16 @@ inline int extruder::getTarget()
   return targetTemperature;
 }
 
+// Called from the stepping interrupt, so no digitalWrite()
+
 inline void extruder::enableStep()
 {
-  if(step_en_pin < 0)
+  if(!en_port)
     return;
-  digitalWrite(step_en_pin, ENABLE_ON); 
+  if(ENABLE_ON)
+    *en_port |= en_mask;
+  else
+    *en_port &= ~en_mask;
 }
 
 inline void extruder::disableStep()
@@ -123,10 +135,17 @@ inline void extruder::disableStep()
 }
 
 #if MOVEMENT_TYPE == MOVEMENT_TYPE_STEP_DIR
+// sStep() starts a step pulse and sStepEnd() finishes it, STEP_PULSE_US
+// later (see cartesian_dda::end_steps())
+
 inline void extruder::sStep()
 {
-   digitalWrite(motor_speed_pin, HIGH);
-   digitalWrite(motor_speed_pin, LOW);
+   *step_port |= step_mask;
+}
+
+inline void extruder::sStepEnd()
+{
+   *step_port &= ~step_mask;
 }
 #else 
 error TODO not yet implemented hjere
@@ -189,6 +208,7 @@ public:
    int getTarget();
    void manage();
    void sStep();
+   void sStepEnd();
    void enableStep();
    void disableStep();
    int potVoltage();
@@ -314,9 +334,9 @@ inline void extruder::setDirection(bool direction)
 //     buildCommand(DIRECTION, '0');
 //   talker.sendPacketAndCheckAcknowledgement(my_name, commandBuffer);
    if(direction)
-     digitalWrite(E_DIR_PIN, 1);
+     fastDigitalWrite(E_DIR_PIN, 1);
    else
-     digitalWrite(E_DIR_PIN, 0);
+     fastDigitalWrite(E_DIR_PIN, 0);
 }
 
 
@@ -326,9 +346,15 @@ inline  void extruder::sStep()
    //talker.sendPacketAndCheckAcknowledgement(my_name, commandBuffer); 
    stp = !stp;
    if(stp)
-     digitalWrite(E_STEP_PIN, 1);
+     fastDigitalWrite(E_STEP_PIN, 1);
    else
-     digitalWrite(E_STEP_PIN, 0);
+     fastDigitalWrite(E_STEP_PIN, 0);
+}
+
+// Each edge is a step to the extruder controller, so there's no pulse to end
+
+inline  void extruder::sStepEnd()
+{
 }
 
 inline  void extruder::enableStep()
@@ -412,6 +438,7 @@ public:
    void slowManage();
    void manage();
    void sStep();
+   void sStepEnd();
    void enableStep();
    void disableStep();
    void shutdown();
@@ -437,6 +464,12 @@ private:
 
 // The pins we control
    byte motor_step_pin, motor_dir_pin, heater_pin,  temp_pin,  motor_en_pin;
+   
+// Where the step, direction and enable pins live, for fast stepping
+   volatile uint8_t* step_port;
+   volatile uint8_t* dir_port;
+   volatile uint8_t* en_port;
+   uint8_t step_mask, dir_mask, en_mask;
 
    //byte fan_pin;
     
@@ -458,10 +491,17 @@ inline float extruder::getLength()
   return savedLength;
 }
 
+// sStep() starts a step pulse and sStepEnd() finishes it, STEP_PULSE_US
+// later (see cartesian_dda::end_steps())
+
 inline void extruder::sStep()
 {
-	digitalWrite(motor_step_pin, HIGH);
-	digitalWrite(motor_step_pin, LOW);  
+	*step_port |= step_mask;
+}
+
+inline void extruder::sStepEnd()
+{
+	*step_port &= ~step_mask;  
 }
 
 inline void extruder::controlTemperature()
@@ -490,7 +530,10 @@ inline void extruder::manage()
 
 inline void extruder::setDirection(bool direction)
 {
-  digitalWrite(motor_dir_pin, direction);  
+  if(direction)
+    *dir_port |= dir_mask;
+  else
+    *dir_port &= ~dir_mask;  
 }
 
 inline void extruder::setCooler(byte e_speed)
@@ -515,9 +558,14 @@ inline int extruder::getTarget()
 
 
 
+// Called from the stepping interrupt, so no digitalWrite()
+
 inline void extruder::enableStep()
 {
-    digitalWrite(motor_en_pin, ENABLE_ON);
+    if(ENABLE_ON)
+      *en_port |= en_mask;
+    else
+      *en_port &= ~en_mask;
 }
 
 inline void extruder::disableStep()
@@ -543,6 +591,7 @@ inline void extruder::valveSet(bool closed, int dTime)
 
 extern extruder* ex[ ];
 extern byte extruder_in_use;
+extern byte extruder_queued;
 
 inline float extruder::stepsPerMM()
 {
@@ -7,7 +7,8 @@
 
 
 
-// Select a new extruder
+// Select a new extruder.  Its length and steps/mm apply to the moves
+// queued from now on; the interrupt changes over when it gets here.
 
 void newExtruder(byte e)
 {
@@ -16,12 +17,13 @@ void newExtruder(byte e)
   if(e >= EXTRUDER_COUNT)
     return;
 
-  if(e != extruder_in_use)
+  if(e != extruder_queued)
   {
-    ex[extruder_in_use]->setLength(where_i_am.e);
-    extruder_in_use = e;
-    where_i_am.e = ex[extruder_in_use]->getLength();
-    setUnits(cdda[0]->get_units());
+    ex[extruder_queued]->setLength(where_i_am.e);
+    extruder_queued = e;
+    where_i_am.e = ex[extruder_queued]->getLength();
+    dda.set_units();
+    qToolChange(e);
   }
 }
 
@@ -119,6 +121,14 @@ extruder::extruder(byte md_pin, byte ms_pin, byte h_pin, byte f_pin, byte t_pin,
   valve_en_pin = ve_pin;
   step_en_pin = se_pin;
   sPerMM = spm;
+  step_port = pinToPort(motor_speed_pin);
+  step_mask = pinToBitMask(motor_speed_pin);
+  if(step_en_pin < digitalPinCount)
+  {
+    en_port = pinToPort(step_en_pin);
+    en_mask = pinToBitMask(step_en_pin);
+  } else
+    en_port = 0;
   
   //setup our pins
   pinMode(motor_dir_pin, OUTPUT);
@@ -311,6 +321,12 @@ extruder::extruder(PIDcontrol* pid, byte stp, byte dir, byte en, byte heat, byte
   sPerMM = spm;
   manageCount = 0;
   extruderPID = pid;
+  step_port = pinToPort(motor_step_pin);
+  step_mask = pinToBitMask(motor_step_pin);
+  dir_port = pinToPort(motor_dir_pin);
+  dir_mask = pinToBitMask(motor_dir_pin);
+  en_port = pinToPort(motor_en_pin);
+  en_mask = pinToBitMask(motor_en_pin);
   
   //fan_pin = ;
 
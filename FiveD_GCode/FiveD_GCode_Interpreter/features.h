@@ -193,19 +193,43 @@
 // Useful to have its square
 #define SMALL_DISTANCE2 (SMALL_DISTANCE*SMALL_DISTANCE) // *RO
 
+// The same in the nanometres the planner uses
+#define SMALL_DISTANCE_NM (unsigned long)(SMALL_DISTANCE*1000000.0) // *RO
+
 //our command string length
 #define COMMAND_SIZE 128 // *RO
 
 // Our response string length
 #define RESPONSE_SIZE 256 // *RO
 
-// The size of the movement buffer
-#define BUFFER_SIZE 4 // *RO
+// The size of the movement buffer.  A MoveBlock is 72 bytes, so that's
+// about 1K on a Mega, and less than the old four-move buffer elsewhere.
+#if defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+#define BUFFER_SIZE 16 // *RO
+#else
+#define BUFFER_SIZE 8 // *RO
+#endif
 
 // Number of microseconds between timer interrupts when no movement
 // is happening
 #define DEFAULT_TICK (long)1000 // *RO
 
+// Timer ticks per second (clk/8 - see setTimerTicks()).  speed_lookuptable.h
+// has tables for 16 and 20MHz; for any other clock make them with
+// createSpeedLookupTable.py.
+#define TIMER_TICKS_PER_SECOND (F_CPU/8.0) // *RO
+
+// DEFAULT_TICK in timer ticks
+#define DEFAULT_TIMER_TICKS ((unsigned long)(DEFAULT_TICK*(TIMER_TICKS_PER_SECOND/1000000.0))) // *RO
+
+// Feedrates (mm/minute) below this are taken as no feedrate at all, and
+// the move goes at SLOW_XY_FEEDRATE or SLOW_Z_FEEDRATE (see set_target())
+#define MIN_FEEDRATE 1.0 // *RO
+
+// Slow moves run the interrupt up to 2^MAX_SMOOTHING times per step of the
+// longest axis (see SMOOTH_STEP_RATE)
+#define MAX_SMOOTHING 3 // *RO
+
 // What delay value to use when waiting for things to free up in milliseconds
 #define WAITING_DELAY 1 // *RO
 
@@ -221,6 +245,13 @@
 // Not sure if this is the best place for...
 
 extern volatile byte endstop_hits;
+extern volatile byte homing_faults;
+
+// How many moves were slowed down because the queue was short, and
+// how many times it ran dry while moves were being sent (see M132)
+
+extern unsigned int queue_slowdowns;
+extern unsigned int queue_underruns;
 
 #endif
 
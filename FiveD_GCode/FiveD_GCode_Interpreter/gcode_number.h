@@ -0,0 +1,103 @@
+#ifndef GCODE_NUMBER_H
+#define GCODE_NUMBER_H
+
+// Reading the numbers in G-code words, without strtod() (see parse_char()
+// in process_g_code.pde).  tools/decimal_test.cpp checks these against
+// strtod() on the PC.
+
+// The line is parsed a byte at a time as it arrives (see parse_char()), so
+// by the time the '\n' comes gc is filled in and the checksum is known.
+// This is where parse_char() has got to.
+
+struct LineParser
+{
+    char word;          // The letter whose number is being read, or 0
+    bool star;          // Past the '*', so stop adding to the checksum
+    bool sign;          // Had a + or -
+    bool negative;
+    bool point;         // Had the decimal point
+    bool digits;        // Had at least one digit
+    byte scale;         // Digits after the point in m
+    byte big;           // Digits before the point that didn't fit in m
+    unsigned long m;    // The digits
+};
+
+// G, M, T, N and * take whole numbers; everything else can have a point
+
+inline bool integer_word(char c)
+{
+  return c == 'G' || c == 'M' || c == 'T' || c == 'N' || c == '*';
+}
+
+inline void start_word(LineParser& lp, char c)
+{
+  lp.word = c;
+  lp.sign = false;
+  lp.negative = false;
+  lp.point = false;
+  lp.digits = false;
+  lp.scale = 0;
+  lp.big = 0;
+  lp.m = 0;
+}
+
+// Does c carry on the number being read?  The rules are strtod()'s and
+// strtol()'s without exponents: spaces, then [+-]digits[.digits]
+
+inline bool number_char(LineParser& lp, char c)
+{
+  if(c >= '0' && c <= '9')
+  {
+    lp.digits = true;
+    if(!lp.point)
+    {
+      if(lp.m < 429496729)
+        lp.m = lp.m*10 + (c - '0');
+      else
+        lp.big++;
+    } else if(lp.m < 429496729 && !lp.big)
+    {
+      lp.m = lp.m*10 + (c - '0');
+      lp.scale++;
+    }
+    return true;
+  }
+  if(c == '.' && !lp.point && !integer_word(lp.word))
+  {
+    lp.point = true;
+    return true;
+  }
+  if(lp.digits || lp.point || lp.sign)
+    return false;
+  if(c == '-' || c == '+')
+  {
+    lp.sign = true;
+    lp.negative = (c == '-');
+    return true;
+  }
+  return c == ' ';
+}
+
+// The number's value.  The digits are turned into a float with one divide,
+// not strtod(), which is slow on the AVR.  The answer is the same as
+// strtod()'s to the last bit for up to 7 significant digits, and within one
+// bit after that.
+
+inline float word_float(const LineParser& lp)
+{
+  float f = (float)lp.m;
+  float d = 1.0;
+  for(byte s = lp.scale; s; s--)
+    d *= 10.0;
+  f = f/d;
+  if(lp.big)
+  {
+    d = 1.0;
+    for(byte b = lp.big; b; b--)
+      d *= 10.0;
+    f *= d;
+  }
+  return lp.negative ? -f : f;
+}
+
+#endif
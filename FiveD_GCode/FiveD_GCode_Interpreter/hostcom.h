@@ -11,7 +11,7 @@
   All communication is in printable ASCII characters.  Messages sent back
   to the host computer are terminated by a newline and look like this:
   
-  xx [line number to resend] [T:93.2 B:22.9] [C: X:9.2 Y:125.4 Z:3.7 E:1902.5] [Some debugging or other information may be here]
+  xx [line number to resend] [T:93.2 B:22.9] [C: X:9.2 Y:125.4 Z:3.7 E:1902.5] [L: X:9.1 Y:125.4 Z:3.7 E:1902.3] [Some debugging or other information may be here]
   
   where xx can be one of:
   
@@ -32,6 +32,11 @@
   
   C: means that coordinates follow.  Those are the X: Y: etc values.  These are only 
   sent in response to a request using the appropriate M code.
+  
+  L: means that the live position follows - where the steppers have actually got to,
+  as opposed to the C: position that the G codes so far received will end up at.
+  This is sent with C: in response to M114.  The two E:s can be for different
+  extruders: C: is for the last one selected with T, L: for the one running now.
 
   The most common response is simply:
 
@@ -64,6 +69,7 @@ public:
   void setETemp(int et);
   void setBTemp(int bt);
   void setCoords(const FloatPoint& where);
+  void setLiveCoords(const FloatPoint& where);
   void capabilities();
   void setResend(long ln);
   void setFatal();
@@ -95,9 +101,11 @@ private:
   float y;
   float z;
   float e;
+  FloatPoint live;
   long resend;
   bool fatal;
   bool sendCoordinates;  
+  bool sendLiveCoordinates;
   bool sendCapabilities;
 };
 
@@ -142,6 +150,7 @@ inline void hostcom::reset()
   message[0] = 0;
   resend = -1;
   sendCoordinates = false;
+  sendLiveCoordinates = false;
   sendCapabilities = false;
   // Don't reset fatal.
 }
@@ -197,6 +206,14 @@ inline void hostcom::setCoords(const FloatPoint& where)
   sendCoordinates = true;
 }
 
+// Set the position the steppers have got to to be returned
+
+inline void hostcom::setLiveCoords(const FloatPoint& where)
+{
+  live = where;
+  sendLiveCoordinates = true;
+}
+
 // tell the host what our key compile-time features are - see M115
 inline void hostcom::capabilities()
 {
@@ -274,6 +291,18 @@ inline void hostcom::sendMessage(bool doMessage)
     put(e);
   }
   
+  if(sendLiveCoordinates)
+  {
+    put(" L: X:");
+    put(live.x);
+    put(" Y:");
+    put(live.y);
+    put(" Z:");
+    put(live.z);
+    put(" E:");
+    put(live.e);
+  }
+  
   if(sendCapabilities) 
   {  
     //TODO  - WE MOST LIKELY DON"T NEED ALL THESE, AND SOME EVEN DUPLICATE INFO, BUT UNTILL WE STABILISE THE SPEC
@@ -305,6 +334,12 @@ inline void hostcom::sendMessage(bool doMessage)
     put("X-THERMAL_CONTROL:"); put(THERMAL_CONTROL); putWs();
     put("X-DATA_SOURCE:"); put(DATA_SOURCE); putWs();
     put("X-ACCELERATION:"); put(ACCELERATION); putWs();
+    put("X-DOUBLE_STEP_RATE:"); put(DOUBLE_STEP_RATE); putWs();
+    put("X-QUAD_STEP_RATE:"); put(QUAD_STEP_RATE); putWs();
+    put("X-SMOOTH_STEP_RATE:"); put(SMOOTH_STEP_RATE); putWs();
+    put("X-SLOWDOWN_QUEUE_TIME:"); put(SLOWDOWN_QUEUE_TIME); putWs();
+    put("X-ARC_TOLERANCE:"); put(ARC_TOLERANCE); putWs();
+    put("X-STEPPER_IDLE_TIME:"); put(STEPPER_IDLE_TIME); putWs();
     put("X-HEATED_BED:"); put(HEATED_BED); putWs();
     put("X-STEPPER_BOARD:"); put(STEPPER_BOARD); putWs();
     put("X-INVERT_X_DIR:"); put(INVERT_X_DIR); putWs();
@@ -217,7 +217,7 @@ void PIDcontrol::pidCalculation()
     float derivative = (error - previousError)/dt;
     previousError = error;
     output = (int)(error*pGain + integral*iGain + derivative*dGain);
-    if(!doingBed && cdda[tail]->extruding())
+    if(!doingBed && dda.extruding())
       output += EXTRUDING_INCREASE;
     output = constrain(output, 0, 255);
   }
@@ -234,4 +234,4 @@ void PIDcontrol::pidCalculation()
 
 
 
-#endif
+#endif
@@ -17,6 +17,7 @@ http://objects.reprap.org/wiki/Mendel_User_Manual:_RepRapGCodes
 #include "extruder.h"
 #include "vectors.h"
 #include "cartesian_dda.h"
+#include "gcode_number.h"
 #include <string.h>
 
 /* bit-flags for commands and parameters */
@@ -38,21 +39,6 @@ http://objects.reprap.org/wiki/Mendel_User_Manual:_RepRapGCodes
 #define GCODE_J	(1<<15)
 
 
-#define PARSE_INT(ch, str, len, val, seen, flag) \
-	case ch: \
-		len = scan_int(str, &val, &seen, flag); \
-		break;
-
-#define PARSE_LONG(ch, str, len, val, seen, flag) \
-	case ch: \
-		len = scan_long(str, &val, &seen, flag); \
-		break;
-
-#define PARSE_FLOAT(ch, str, len, val, seen, flag) \
-	case ch: \
-		len = scan_float(str, &val, &seen, flag); \
-		break;
-
 /* gcode line parse results */
 struct GcodeParser
 {
@@ -72,6 +58,7 @@ struct GcodeParser
     float R;
     float Q;
     int Checksum;
+    byte LineChecksum; // What Checksum should be - worked out as the line arrives
     long N;
     long LastLineNrRecieved;
 };
@@ -95,93 +82,155 @@ FloatPoint sp;
 byte SendDebug =  DEBUG_INFO | DEBUG_ERRORS;
 
         
-// The following three inline functions are used for things like return to 0
+// Homing moves.  Move the axes in axes (X_LOW_HIT etc.) by d, leaving the others where they are.
+// If must_hit is set the move has to finish on the endstops of all of them.
 
-inline void specialMoveX(const float& x, const float& feed)
+inline void homingMove(byte axes, const float& d, const float& feed, bool must_hit)
 {
   sp = where_i_am;
-  sp.x = x;
+  if(axes & X_LOW_HIT)
+    sp.x += d;
+  if(axes & Y_LOW_HIT)
+    sp.y += d;
+  if(axes & Z_LOW_HIT)
+    sp.z += d;
   sp.f = feed;
-  qMove(sp);
+  qMove(sp, must_hit ? axes : 0);
 }
 
-inline void specialMoveY(const float& y, const float& feed)
-{
-  sp = where_i_am;
-  sp.y = y;
-  sp.f = feed;
-  qMove(sp);
-}
+// Once the moves to home axes are queued, that's where the machine will be
 
-inline void specialMoveZ(const float& z, const float& feed)
+inline void homed(byte axes)
 {
   sp = where_i_am;
-  sp.z = z; 
-  sp.f = feed;
-  qMove(sp);
+  if(axes & X_LOW_HIT)
+    sp.x = 0;
+  if(axes & Y_LOW_HIT)
+    sp.y = 0;
+  if(axes & Z_LOW_HIT)
+    sp.z = 0;
+  setPosition(sp);
 }
 
-void zeroX()
+// Arcs.  Go from where_i_am to p round the centre at offset (i, j) from
+// where_i_am, clockwise or not.  Z and E change evenly along the way.
+// The arc is cut into straight moves, each one the previous one turned
+// through the same angle, so there's no sin or cos for every segment.
+
+void arcMove(const FloatPoint& p, float i, float j, bool clockwise)
 {
-  where_i_am.f = SLOW_XY_FEEDRATE;
-  specialMoveX(where_i_am.x - 5, FAST_XY_FEEDRATE);
-  specialMoveX(where_i_am.x - 250, FAST_XY_FEEDRATE);
-  where_i_am.x = 0;
-  where_i_am.f = SLOW_XY_FEEDRATE;
-  specialMoveX(where_i_am.x + 1, SLOW_XY_FEEDRATE);
-  specialMoveX(where_i_am.x - 10, SLOW_XY_FEEDRATE);                                
-  where_i_am.x = 0;
- 
-  // Wait for movements to finish, then check we hit the stop
- 
-  while(!qEmpty()) manage();
-  if(!(endstop_hits & X_LOW_HIT))
+  float cx = where_i_am.x + i;
+  float cy = where_i_am.y + j;
+  float rx = -i;               // From the centre to where we are
+  float ry = -j;
+  float tx = p.x - cx;         // ...and to where we're going
+  float ty = p.y - cy;
+  float radius = sqrt(rx*rx + ry*ry);
+  
+  // How far round?  The same start and finish means a whole circle.
+  
+  float angle = atan2(rx*ty - ry*tx, rx*tx + ry*ty);
+  if(clockwise)
   {
-    sprintf(talkToHost.string(), "X endstop not hit - hard fault.");
-    talkToHost.setFatal();
-  }  
+    if(angle >= 0)
+      angle -= 2.0*M_PI;
+  } else
+  {
+    if(angle <= 0)
+      angle += 2.0*M_PI;
+  }
+  
+  // Each segment turns through the biggest angle that keeps its middle
+  // within ARC_TOLERANCE of the arc
+  
+  float c = 1.0 - ARC_TOLERANCE/radius;
+  if(c < 0.0)
+    c = 0.0;
+  int segments = (int)ceil(fabs(angle)/(2.0*acos(c)));
+  if(segments < 1)
+    segments = 1;
+  
+  float theta = angle/segments;
+  float cos_t = cos(theta);
+  float sin_t = sin(theta);
+  float start_angle = atan2(ry, rx);
+  FloatPoint step = p - where_i_am;
+  step.z /= segments;
+  step.e /= segments;
+  
+  sp = where_i_am;
+  sp.f = p.f;
+  for(int s = 1; s < segments; s++)
+  {
+    if(s % ARC_CORRECTION)
+    {
+      float r = rx*sin_t + ry*cos_t;
+      rx = rx*cos_t - ry*sin_t;
+      ry = r;
+    } else
+    {
+      rx = radius*cos(start_angle + s*theta);
+      ry = radius*sin(start_angle + s*theta);
+    }
+    sp.x = cx + rx;
+    sp.y = cy + ry;
+    sp.z += step.z;
+    sp.e += step.e;
+    qMove(sp);
+  }
+  
+  // Finish exactly where we were asked to
+  
+  qMove(p);
 }
 
-void zeroY()
+// Go home on the axes in axes (X_LOW_HIT etc.).  X and Y go together, then Z:
+// fast towards the endstops (each axis stops when it gets there), back
+// off, and slowly in again.  All that goes in the queue, so G28 returns
+// straight away and the host can carry on sending.  If the slow move doesn't
+// finish on the endstops the interrupt notices, and checkHoming() makes
+// it a hard fault.
+
+void home(byte axes)
 {
-  specialMoveY(where_i_am.y - 5, FAST_XY_FEEDRATE);
-  specialMoveY(where_i_am.y - 250, FAST_XY_FEEDRATE);
-  where_i_am.y = 0;
-  where_i_am.f = SLOW_XY_FEEDRATE;
-  specialMoveY(where_i_am.y + 1, SLOW_XY_FEEDRATE);
-  specialMoveY(where_i_am.y - 10, SLOW_XY_FEEDRATE);                                
-  where_i_am.y = 0;
- 
-  // Wait for movements to finish, then check we hit the stop
+  byte xy = axes & (X_LOW_HIT | Y_LOW_HIT);
+  if(xy)
+  {
+    homingMove(xy, -5, FAST_XY_FEEDRATE, false);
+    homingMove(xy, -250, FAST_XY_FEEDRATE, false);
+    homed(xy);
+    homingMove(xy, 1, SLOW_XY_FEEDRATE, false);
+    homingMove(xy, -10, SLOW_XY_FEEDRATE, true);
+    homed(xy);
+  }
   
-  while(!qEmpty()) manage();
-  if(!(endstop_hits & Y_LOW_HIT))
+  if(axes & Z_LOW_HIT)
   {
-    sprintf(talkToHost.string(), "Y endstop not hit - hard fault.");
-    talkToHost.setFatal();
-  }   
-   
+    homingMove(Z_LOW_HIT, -0.5, FAST_Z_FEEDRATE, false);
+    homingMove(Z_LOW_HIT, -250, FAST_Z_FEEDRATE, false);
+    homed(Z_LOW_HIT);
+    homingMove(Z_LOW_HIT, 1, SLOW_Z_FEEDRATE, false);
+    homingMove(Z_LOW_HIT, -2, SLOW_Z_FEEDRATE, true);
+    homed(Z_LOW_HIT);
+  }
 }
 
-void zeroZ()
-{
-  where_i_am.f = SLOW_Z_FEEDRATE;
-  specialMoveZ(where_i_am.z - 0.5, FAST_Z_FEEDRATE);
-  specialMoveZ(where_i_am.z - 250, FAST_Z_FEEDRATE);
-  where_i_am.z = 0;
-  where_i_am.f = SLOW_Z_FEEDRATE;
-  specialMoveZ(where_i_am.z + 1, SLOW_Z_FEEDRATE);
-  specialMoveZ(where_i_am.z - 2, SLOW_Z_FEEDRATE);                                
-  where_i_am.z = 0;
-  
-  // Wait for movements to finish, then check we hit the stop
+// Called from manage(): did a homing move miss its endstops?
 
-  while(!qEmpty()) manage();
-  if(!(endstop_hits & Z_LOW_HIT))
-  {
+void checkHoming()
+{
+  byte missed = homing_faults;
+  if(!missed)
+    return;
+  homing_faults = 0;
+  cancelAndClearQueue();
+  if(missed & X_LOW_HIT)
+    sprintf(talkToHost.string(), "X endstop not hit - hard fault.");
+  else if(missed & Y_LOW_HIT)
+    sprintf(talkToHost.string(), "Y endstop not hit - hard fault.");
+  else
     sprintf(talkToHost.string(), "Z endstop not hit - hard fault.");
-    talkToHost.setFatal();
-  }     
+  talkToHost.setFatal();
 }
 
 //our feedrate variables.
@@ -196,17 +245,247 @@ boolean abs_mode = true; //0 = incremental; 1 = absolute
 
 float extruder_speed = 0;
 
-int scan_int(char *str, int *valp);
-int scan_float(char *str, float *valp);
-
 GcodeParser gc;	/* string parse result */
+LineParser lp;
+
+
+// M codes that change things (temperatures, fans, valves...) rather than
+// report or wait for them don't need the moves in front of them finished
+// first.  They go in the queue, and doMCode() does them when it gets there.
+// The valves stop the machine while they work; the rest don't.
+
+bool queueMCode()
+{
+  float v = 0.0;
+  switch(gc.M)
+  {
+    case 104:
+    case 140:
+      if(!(gc.seen & GCODE_S))
+        return true;
+      v = gc.S;
+      break;
+    
+    case 106:
+    case 107:
+      break;
+      
+    case 108:
+    case 113:
+      v = (gc.seen & GCODE_S) ? gc.S : -1.0;
+      break;
+      
+    case 126:
+    case 127:
+      qCommand(gc.M, gc.P, true);
+      return true;
+      
+    default:
+      return false;
+  }
+  qCommand(gc.M, v, false);
+  return true;
+}
+
+// M codes that only report things can be answered straight away from how
+// things are now.  Waiting for the queue to empty first would stop the
+// machine every time the host polls the temperature.
+
+bool reportMCode()
+{
+  switch(gc.M)
+  {
+			//custom code for temperature reading
+			case 105:
+                                talkToHost.setETemp(ex[extruder_in_use]->getTemperature());
+#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_RS485
+#if HEATED_BED == HEATED_BED_ON
+                                talkToHost.setBTemp(ex[0]->getBedTemperature());
+#endif
+#endif
+#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_INTERNAL
+#if HEATED_BED == HEATED_BED_ON
+                                talkToHost.setBTemp(heatedBed.getTemperature());
+#endif
+#endif
+				break;
+
+			//custom code for returning current coordinates
+			case 114:
+                                talkToHost.setCoords(where_i_am);
+                                talkToHost.setLiveCoords(dda.position());
+				break;
+
+			//Reserved for returning machine capabilities in keyword:value pairs
+			//custom code for returning Firmware Version and Capabilities 
+			case 115:
+                                talkToHost.capabilities();
+				break;
 
+                        // Report how often the move queue got short or ran dry; S0 resets the counts
+                        case 132:
+                                sprintf(talkToHost.string(), "Queue slowdowns: %u underruns: %u", queue_slowdowns, queue_underruns);
+                                if((gc.seen & GCODE_S) && gc.S == 0)
+                                {
+                                  queue_slowdowns = 0;
+                                  queue_underruns = 0;
+                                }
+                                break;
+
+    default:
+      return false;
+  }
+  return true;
+}
+
+void doMCode(byte m, float v, byte e)
+{
+  switch(m)
+  {
+                        // The interrupt has moved on from extruder e (see dQMove()).
+                        // If it's come back to it since, leave it on.
+                        case TOOL_CHANGE:
+                                if(e != extruder_in_use)
+                                        ex[e]->disableStep();
+                                break;
+
+			//custom code for temperature control
+			case 104:
+				ex[e]->setTemperature((int)v);
+				break;
+
+			//turn fan on
+			case 106:
+				ex[e]->setCooler(255);
+				break;
+
+			//turn fan off
+			case 107:
+				ex[e]->setCooler(0);
+				break;
+
+// If there's an S field, use that to set the PWM, otherwise use the pot.
+                       case 108: // Depricated
+                       case 113:
+                                #if MOTHERBOARD == 2
+                                 if (v >= 0.0)
+                                     ex[e]->setPWM((int)(255.0*v + 0.5));
+                                  else
+                                     ex[e]->usePotForMotor();
+                                #endif
+				break;
+
+// The valve (real, or virtual...) is now the way to control any extruder (such as
+// a pressurised paste extruder) that cannot move using E codes.
+
+                        // Open the valve
+                        case 126:
+                                ex[e]->valveSet(true, (int)(v + 0.5));
+                                break;
+                                
+                        // Close the valve
+                        case 127:
+                                ex[e]->valveSet(false, (int)(v + 0.5));
+                                break;
+
+                        case 140:
+#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_RS485
+#if HEATED_BED == HEATED_BED_ON
+				ex[0]->setBedTemperature((int)v);
+#endif
+#endif
+#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_INTERNAL
+#if HEATED_BED == HEATED_BED_ON
+  				heatedBed.setTemperature((int)v);
+#endif
+#endif				
+				break;
+                                
+                        default:
+                                break;
+  }
+}
 
 //init our string processing
 inline void init_process_string()
 {
   serial_count = 0;
   comment = false;
+  gc.seen = 0;
+  gc.LineChecksum = 0;
+  lp.word = 0;
+  lp.star = false;
+}
+
+inline bool word_letter(char c)
+{
+  switch(c)
+  {
+    case 'G': case 'M': case 'T': case 'S': case 'P': case 'X': case 'Y': case 'Z':
+    case 'I': case 'J': case 'F': case 'R': case 'Q': case 'E': case 'N': case '*':
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The number is finished; store it in gc
+
+void end_word()
+{
+  char w = lp.word;
+  lp.word = 0;
+  if(!lp.digits)
+    return;
+    
+  long l = lp.negative ? -(long)lp.m : (long)lp.m;
+  switch(w)
+  {
+    case 'G': gc.G = l; gc.seen |= GCODE_G; return;
+    case 'M': gc.M = l; gc.seen |= GCODE_M; return;
+    case 'T': gc.T = l; gc.seen |= GCODE_T; return;
+    case 'N': gc.N = l; gc.seen |= GCODE_N; return;
+    case '*': gc.Checksum = l; gc.seen |= GCODE_CHECKSUM; return;
+    default: break;
+  }
+  
+  float f = word_float(lp);
+    
+  switch(w)
+  {
+    case 'S': gc.S = f; gc.seen |= GCODE_S; break;
+    case 'P': gc.P = f; gc.seen |= GCODE_P; break;
+    case 'X': gc.X = f; gc.seen |= GCODE_X; break;
+    case 'Y': gc.Y = f; gc.seen |= GCODE_Y; break;
+    case 'Z': gc.Z = f; gc.seen |= GCODE_Z; break;
+    case 'I': gc.I = f; gc.seen |= GCODE_I; break;
+    case 'J': gc.J = f; gc.seen |= GCODE_J; break;
+    case 'F': gc.F = f; gc.seen |= GCODE_F; break;
+    case 'R': gc.R = f; gc.seen |= GCODE_R; break;
+    case 'Q': gc.Q = f; gc.seen |= GCODE_Q; break;
+    case 'E': gc.E = f; gc.seen |= GCODE_E; break;
+  }
+}
+
+// Take the next character of the line (comments have already been dropped)
+
+void parse_char(char c)
+{
+  if(!lp.star)
+  {
+    if(c == '*')
+      lp.star = true;
+    else
+      gc.LineChecksum ^= c;
+  }
+  if(lp.word)
+  {
+    if(number_char(lp, c))
+      return;
+    end_word();
+  }
+  if(word_letter(c))
+    start_word(lp, c);
 }
 
 // Get a command and process it
@@ -233,7 +512,10 @@ void get_and_do_command()
 				
 			// If we're not in comment mode, add it to our array.
 			if (!comment)
+			{
 				cmdbuffer[serial_count++] = c;
+				parse_char(c);
+			}
 		  }
 
                 }
@@ -247,6 +529,8 @@ void get_and_do_command()
 	{
                 // Terminate string
                 cmdbuffer[serial_count] = 0;
+                if(lp.word)
+                  end_word();
                 
                 if(SendDebug & DEBUG_ECHO)
                    sprintf(talkToHost.string(), "Echo: %s", cmdbuffer);
@@ -266,45 +550,6 @@ void get_and_do_command()
 
 
 
-void parse_string(struct GcodeParser * gc, char instruction[ ], int size)
-{
-	int ind;
-	int len;	/* length of parameter argument */
-
-	gc->seen = 0;
-
-	len=0;
-	/* scan the string for commands and parameters, recording the arguments for each,
-	 * and setting the seen flag for each that is seen
-	 */
-	for (ind=0; ind<size; ind += (1+len))
-	{
-		len = 0;
-		switch (instruction[ind])
-		{
-			  PARSE_INT('G', &instruction[ind+1], len, gc->G, gc->seen, GCODE_G);
-			  PARSE_INT('M', &instruction[ind+1], len, gc->M, gc->seen, GCODE_M);
-			  PARSE_INT('T', &instruction[ind+1], len, gc->T, gc->seen, GCODE_T);
-			PARSE_FLOAT('S', &instruction[ind+1], len, gc->S, gc->seen, GCODE_S);
-			PARSE_FLOAT('P', &instruction[ind+1], len, gc->P, gc->seen, GCODE_P);
-			PARSE_FLOAT('X', &instruction[ind+1], len, gc->X, gc->seen, GCODE_X);
-			PARSE_FLOAT('Y', &instruction[ind+1], len, gc->Y, gc->seen, GCODE_Y);
-			PARSE_FLOAT('Z', &instruction[ind+1], len, gc->Z, gc->seen, GCODE_Z);
-			PARSE_FLOAT('I', &instruction[ind+1], len, gc->I, gc->seen, GCODE_I);
-			PARSE_FLOAT('J', &instruction[ind+1], len, gc->J, gc->seen, GCODE_J);
-			PARSE_FLOAT('F', &instruction[ind+1], len, gc->F, gc->seen, GCODE_F);
-			PARSE_FLOAT('R', &instruction[ind+1], len, gc->R, gc->seen, GCODE_R);
-			PARSE_FLOAT('Q', &instruction[ind+1], len, gc->Q, gc->seen, GCODE_Q);
-			PARSE_FLOAT('E', &instruction[ind+1], len, gc->E, gc->seen, GCODE_E);
-			PARSE_LONG('N', &instruction[ind+1], len, gc->N, gc->seen, GCODE_N);
-			PARSE_INT('*', &instruction[ind+1], len, gc->Checksum, gc->seen, GCODE_CHECKSUM);
-                        default:
-			  break;
-		}
-	}
-}
-
-
 //Read the string and execute instructions
 void process_string(char instruction[], int size)
 {
@@ -313,7 +558,7 @@ void process_string(char instruction[], int size)
 		return;
 
         float fr;
-        bool axisSelected;
+        byte axes;
         
 	fp.x = 0.0;
 	fp.y = 0.0;
@@ -321,9 +566,7 @@ void process_string(char instruction[], int size)
         fp.e = 0.0;
         fp.f = 0.0;
 
-	//get all our parameters!
-	parse_string(&gc, instruction, size);
-  
+	// get_and_do_command() has parsed it already
   
         // Do we have lineNr and checksums in this gcode?
         if((bool)(gc.seen & GCODE_CHECKSUM) | (bool)(gc.seen & GCODE_N))
@@ -344,12 +587,8 @@ void process_string(char instruction[], int size)
           // Check checksum of this string. Flush buffers and re-request line of error is found
           if(gc.seen & GCODE_CHECKSUM)  // if we recieved a line nr, we know we also recieved a Checksum, so check it
           {
-            // Calc checksum.
-            byte checksum = 0;
-            byte count=0;
-            while(instruction[count] != '*')
-              checksum = checksum^instruction[count++];
             // Check checksum.
+            byte checksum = gc.LineChecksum;
             if(gc.Checksum != (int)checksum)
             {
               if(SendDebug & DEBUG_ERRORS)
@@ -419,8 +658,8 @@ void process_string(char instruction[], int size)
 		if ( gc.seen & GCODE_F )
 			fp.f = gc.F;
                
-                // Process the buffered move commands first
-                // If we get one, return immediately
+                // All the G codes go in the queue, or just change how we
+                // read the ones after them, so none of them has to wait for it
 
 		switch (gc.G)
                 {
@@ -437,90 +676,70 @@ void process_string(char instruction[], int size)
                                  qMove(fp);
                                  return;                                  
                                 
+                        // Clockwise and anticlockwise arcs round the centre offset by I and J
+			case 2:
+			case 3:
+                                 arcMove(fp, (gc.seen & GCODE_I) ? gc.I : 0.0, (gc.seen & GCODE_J) ? gc.J : 0.0, gc.G == 2);
+                                 return;
+                                
                         //go home.  If we send coordinates (regardless of their value) only zero those axes
 			case 28:
-                                axisSelected = false;
+                                axes = 0;
                                 if(gc.seen & GCODE_X)
-                                {
-                                  zeroX();
-                                  axisSelected = true;
-                                }
+                                  axes |= X_LOW_HIT;
                                 if(gc.seen & GCODE_Y)
-                                {
-                                  zeroY();
-                                  axisSelected = true;
-                                }                                
+                                  axes |= Y_LOW_HIT;
                                 if(gc.seen & GCODE_Z)
-                                {
-                                  zeroZ();
-                                  axisSelected = true;
-                                }
-                                if(!axisSelected)
-                                {
-                                  zeroX();
-                                  zeroY();
-                                  zeroZ();
-                                }
+                                  axes |= Z_LOW_HIT;
+                                if(!axes)
+                                  axes = X_LOW_HIT | Y_LOW_HIT | Z_LOW_HIT;
+                                home(axes);
                                 where_i_am.f = SLOW_XY_FEEDRATE;     // Most sensible feedrate to leave it in                    
 
 				return;
 
-
-                          default:
-                                break;
-                }
-                
-		// Non-buffered G commands
-                // Wait till the buffer q is empty first
-                    
-                  waitFor_qEmpty();
-                  long endTime;
-		  switch (gc.G)
-		  {
-
-  			 //Dwell
+  			 //Dwell; the queue stops for P milliseconds when it gets here
 			case 4:
-                                endTime = millis() + (int)(gc.P + 0.5);
-				while(millis() < endTime) manage();  
-				break;
+                                qDwell(gc.P);
+				return;
 
 			//Inches for Units
 			case 20:
                                 setUnits(false);
-				break;
+				return;
 
 			//mm for Units
 			case 21:
                                 setUnits(true);
-				break;
+				return;
 
 			//Absolute Positioning
 			case 90: 
 				abs_mode = true;
-				break;
+				return;
 
 			//Incremental Positioning
 			case 91: 
 				abs_mode = false;
-				break;
+				return;
 
 			//Set position as fp
 			case 92: 
                                 setPosition(fp);
-				break;
+				return;
 
 			default:
 				if(SendDebug & DEBUG_ERRORS)
                                   sprintf(talkToHost.string(), "Dud G code: G%d", gc.G);
                                 talkToHost.setResend(gc.LastLineNrRecieved+1);
-		  }
+                }
 	}
 
 
 
         
 	//find us an m code.
-	if (gc.seen & GCODE_M)
+	if ((gc.seen & GCODE_M) && !queueMCode() && !reportMCode())
 	{
             // Wait till the q is empty first
             waitFor_qEmpty();
@@ -560,40 +779,6 @@ void process_string(char instruction[], int size)
 			//turn extruder off
 
 */
-			//custom code for temperature control
-			case 104:
-				if (gc.seen & GCODE_S)
-				{
-					ex[extruder_in_use]->setTemperature((int)gc.S);
-				}
-				break;
-
-			//custom code for temperature reading
-			case 105:
-                                talkToHost.setETemp(ex[extruder_in_use]->getTemperature());
-#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_RS485
-#if HEATED_BED == HEATED_BED_ON
-                                talkToHost.setBTemp(ex[0]->getBedTemperature());
-#endif
-#endif
-#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_INTERNAL
-#if HEATED_BED == HEATED_BED_ON
-                                talkToHost.setBTemp(heatedBed.getTemperature());
-#endif
-#endif
-				break;
-
-			//turn fan on
-			case 106:
-				ex[extruder_in_use]->setCooler(255);
-				break;
-
-			//turn fan off
-			case 107:
-				ex[extruder_in_use]->setCooler(0);
-				break;
-
-
                         // Set the temperature and wait for it to get there
 			case 109:
 				ex[extruder_in_use]->setTemperature((int)gc.S);
@@ -611,30 +796,6 @@ void process_string(char instruction[], int size)
 				shutdown();
 				break;
 
-// If there's an S field, use that to set the PWM, otherwise use the pot.
-                       case 108: // Depricated
-                       case 113:
-                                #if MOTHERBOARD == 2
-                                 if (gc.seen & GCODE_S)
-                                     ex[extruder_in_use]->setPWM((int)(255.0*gc.S + 0.5));
-                                  else
-                                     ex[extruder_in_use]->usePotForMotor();
-                                #endif
-				break;
-
-			//custom code for returning current coordinates
-			case 114:
-                                talkToHost.setCoords(where_i_am);
-				break;
-
-			//Reserved for returning machine capabilities in keyword:value pairs
-			//custom code for returning Firmware Version and Capabilities 
-			case 115:
-                                talkToHost.capabilities();
-				break;
-
-
-
                         // TODO: make this work properly
                         case 116:
                              ex[extruder_in_use]->waitForTemperature();
@@ -645,36 +806,6 @@ void process_string(char instruction[], int size)
                                 talkToHost.setCoords(zeroHit);
 				break;
 
-// The valve (real, or virtual...) is now the way to control any extruder (such as
-// a pressurised paste extruder) that cannot move using E codes.
-
-                        // Open the valve
-                        case 126:
-                                ex[extruder_in_use]->valveSet(true, (int)(gc.P + 0.5));
-                                break;
-                                
-                        // Close the valve
-                        case 127:
-                                ex[extruder_in_use]->valveSet(false, (int)(gc.P + 0.5));
-                                break;
-                                                                
-                        case 140:
-				if (gc.seen & GCODE_S)
-				{
-        
-#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_RS485
-#if HEATED_BED == HEATED_BED_ON
-					ex[0]->setBedTemperature((int)gc.S);
-#endif
-#endif
-#if EXTRUDER_CONTROLLER == EXTRUDER_CONTROLLER_INTERNAL
-#if HEATED_BED == HEATED_BED_ON
-  					heatedBed.setTemperature((int)gc.S);
-#endif
-#endif				
-                                }
-				break;
-
                         case 141: //TODO: set chamber temperature
                                 break;
                                 
@@ -695,72 +826,10 @@ void process_string(char instruction[], int size)
                 
         if (gc.seen & GCODE_T)
         {
-            waitFor_qEmpty();
             newExtruder(gc.T);
         }
 }
 
-int scan_float(char *str, float *valp, unsigned int *seen, unsigned int flag)
-{
-	float res;
-	int len;
-	char *end;
-     
-	res = (float)strtod(str, &end);
-      
-	len = end - str;
-
-	if (len > 0)
-	{
-		*valp = res;
-		*seen |= flag;
-	}
-	else
-		*valp = 0;
-          
-	return len;	/* length of number */
-}
-
-int scan_int(char *str, int *valp, unsigned int *seen, unsigned int flag)
-{
-	int res;
-	int len;
-	char *end;
-
-	res = (int)strtol(str, &end, 10);
-	len = end - str;
-
-	if (len > 0)
-	{
-		*valp = res;
-		*seen |= flag;
-	}
-	else
-		*valp = 0;
-          
-	return len;	/* length of number */
-}
-
-int scan_long(char *str, long *valp, unsigned int *seen, unsigned int flag)
-{
-	long res;
-	int len;
-	char *end;
-
-	res = strtol(str, &end, 10);
-	len = end - str;
-
-	if (len > 0)
-	{
-		*valp = res;
-		*seen |= flag;
-	}
-	else
-		*valp = 0;
-          
-	return len;	/* length of number in ascii world */
-}
-
 void setupGcodeProcessor()
 {
   gc.LastLineNrRecieved = -1;
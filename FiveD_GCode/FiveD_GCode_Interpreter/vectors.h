@@ -4,6 +4,8 @@
 #ifndef VECTORS_H
 #define VECTORS_H
 
+#include <limits.h>
+
 #define round(x) ((x)>=0?(long)((x)+0.5):(long)((x)-0.5))
 
 struct LongPoint;
@@ -113,6 +115,45 @@ inline LongPoint operator-(const LongPoint& a, const LongPoint& b)
 } 
 
 
+// NB - as for FloatPoints, neither the scalar nor the vector product
+
+inline LongPoint operator*(const LongPoint& a, const LongPoint& b)
+{
+  LongPoint result;
+  result.x = a.x * b.x;
+  result.y = a.y * b.y;
+  result.z = a.z * b.z;
+  result.e = a.e * b.e;
+  result.f = a.f * b.f;
+  return result;
+} 
+
+
+// The same, but stopping at what fits in a long rather than overflowing.
+// b is positive and a_max is LONG_MAX/b, worked out once beforehand, so
+// this is all 32-bit.
+
+inline long clamped_product(long a, long b, long a_max)
+{
+  if(a > a_max)
+    return LONG_MAX;
+  if(a < -a_max)
+    return -LONG_MAX;
+  return a*b;
+}
+
+inline LongPoint clamped_product(const LongPoint& a, const LongPoint& b, const LongPoint& a_max)
+{
+  LongPoint result;
+  result.x = clamped_product(a.x, b.x, a_max.x);
+  result.y = clamped_product(a.y, b.y, a_max.y);
+  result.z = clamped_product(a.z, b.z, a_max.z);
+  result.e = clamped_product(a.e, b.e, a_max.e);
+  result.f = clamped_product(a.f, b.f, a_max.f);
+  return result;
+}
+
+
 inline LongPoint absv(const LongPoint& a)
 {
   LongPoint result;
@@ -136,9 +177,18 @@ inline LongPoint roundv(const FloatPoint& a)
   return result;
 } 
 
+// Positions come from the G-code as floats, so this is a float multiply
+// and round per axis.  There are no steps in F, so that's left at 0.
+
 inline LongPoint to_steps(const FloatPoint& units, const FloatPoint& position)
 {
-        return roundv(units*position);
+        LongPoint result;
+        result.x = round(units.x*position.x);
+        result.y = round(units.y*position.y);
+        result.z = round(units.z*position.z);
+        result.e = round(units.e*position.e);
+        result.f = 0;
+        return result;
 }
 
 inline FloatPoint from_steps(const FloatPoint& units, const LongPoint& position)
@@ -149,7 +199,50 @@ inline FloatPoint from_steps(const FloatPoint& units, const LongPoint& position)
         inv.z = 1.0/inv.z;
         inv.e = 1.0/inv.e;
         inv.f = 1.0/inv.f;
-        return roundv(inv*position);
+        return inv*position;
+}
+
+// Integer square root (rounded down), a bit at a time
+
+inline unsigned long isqrt(unsigned long a)
+{
+  unsigned long r = 0;
+  unsigned long bit = 1UL << 30;
+  while(bit > a)
+    bit >>= 2;
+  while(bit)
+  {
+    if(a >= r + bit)
+    {
+      a -= r + bit;
+      r = (r >> 1) + bit;
+    } else
+      r >>= 1;
+    bit >>= 2;
+  }
+  return r;
+}
+
+// The length of (x, y, z) in integer arithmetic.  If the sum of the
+// squares won't fit in 32 bits drop the bottom bits first, and put them
+// back afterwards.
+
+inline unsigned long lengthv(long x, long y, long z)
+{
+  unsigned long ax = labs(x);
+  unsigned long ay = labs(y);
+  unsigned long az = labs(z);
+  unsigned long m = ax | ay | az;
+  byte shift = 0;
+  while(m > 0x7fff)
+  {
+    m >>= 1;
+    shift++;
+  }
+  ax >>= shift;
+  ay >>= shift;
+  az >>= shift;
+  return isqrt(ax*ax + ay*ay + az*az) << shift;
 }
 
 inline FloatPoint::FloatPoint(const LongPoint& a)
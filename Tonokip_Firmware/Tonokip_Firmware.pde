@@ -6,7 +6,11 @@
 // In particular - RepRap-style accelerations added as an option.
 
 #include "configuration.h"
+#include "Sd2PinMap.h" // fastDigitalWrite(); before pins.h, which #defines the SPI pin names it declares
 #include "pins.h"
+#include "feedrate_ramp.h"
+#include "decimal.h"
+#include <util/delay.h>
 
 #ifdef SDSUPPORT
 #include "SdFat.h"
@@ -28,11 +32,9 @@ void ClearToSend();
 
 void get_coordinates();
 
-#ifdef REPRAP_ACC
 void linear_move();
-#else
-void linear_move(unsigned long x_steps_remaining, unsigned long y_steps_remaining, unsigned long z_steps_remaining, unsigned long e_steps_remaining);
-#endif
+void setup_step_timer();
+void wait_for_moves();
 
 void disable_x();
 void disable_y();
@@ -46,6 +48,7 @@ void do_x_step();
 void do_y_step();
 void do_z_step();
 void do_e_step();
+void end_steps();
 
 void kill(byte debug);
 
@@ -103,28 +106,13 @@ void kill(byte debug);
 
 //Stepper Movement Variables
 bool direction_x, direction_y, direction_z, direction_e;
-unsigned long previous_micros=0, previous_micros_x=0, previous_micros_y=0, previous_micros_z=0, previous_micros_e=0, previous_millis_heater, previous_millis_bed_heater;
-unsigned long x_steps_to_take, y_steps_to_take, z_steps_to_take, e_steps_to_take;
-unsigned long long_full_velocity_units = full_velocity_units * 100;
-unsigned long long_travel_move_full_velocity_units = travel_move_full_velocity_units * 100;
-unsigned long max_x_interval = 100000000.0 / (min_units_per_second * x_steps_per_unit);
-unsigned long max_y_interval = 100000000.0 / (min_units_per_second * y_steps_per_unit);
-unsigned long max_interval, interval;
-unsigned long x_min_constant_speed_steps = min_constant_speed_units * x_steps_per_unit,
-  y_min_constant_speed_steps = min_constant_speed_units * y_steps_per_unit, min_constant_speed_steps;
-boolean acceleration_enabled,accelerating;
+unsigned long previous_millis_heater, previous_millis_bed_heater;
 float destination_x =0.0, destination_y = 0.0, destination_z = 0.0, destination_e = 0.0;
 float current_x = 0.0, current_y = 0.0, current_z = 0.0, current_e = 0.0;
-long x_interval, y_interval, z_interval, e_interval; // for speed delay
 float feedrate = 1500, next_feedrate, saved_feedrate, current_feedrate=1500;
-float time_for_move;
-long gcode_N, gcode_LastN;
+long gcode_LastN;
 bool relative_mode = false;  //Determines Absolute or Relative Coordinates
 bool relative_mode_e = false;  //Determines Absolute or Relative E Codes while in Absolute Coordinates mode. E is always relative in Relative Coordinates mode.
-long timediff=0;
-#ifdef STEP_DELAY_RATIO
-long long_step_delay_ratio = STEP_DELAY_RATIO * 100;
-#endif
 
 
 // comm variables
@@ -139,7 +127,36 @@ int i=0;
 char serial_char;
 int serial_count = 0;
 boolean comment_mode = false;
-char *strchr_pointer; // just a pointer to find chars in the cmd string like X, Y, Z, E, etc
+char *strchr_pointer; // just a pointer to find chars in the cmd string (SD file names)
+
+// Each command line is gone through once, by parse_command() when it arrives,
+// and what was found is kept with it here.  The seen bits say which words it had.
+
+#define CODE_G (1<<0)
+#define CODE_M (1<<1)
+#define CODE_T (1<<2)
+#define CODE_X (1<<3)
+#define CODE_Y (1<<4)
+#define CODE_Z (1<<5)
+#define CODE_E (1<<6)
+#define CODE_F (1<<7)
+#define CODE_S (1<<8)
+#define CODE_P (1<<9)
+#define CODE_N (1<<10)
+#define CODE_CHECKSUM (1<<11)
+
+struct parsed_command
+{
+  unsigned int seen;
+  int G, M, T;
+  float X, Y, Z, E, F, S, P;
+  long N;
+  int checksum;       // The number after the '*'
+  byte line_checksum; // What it should be: everything before the '*' XORed together
+};
+
+parsed_command parsed[BUFSIZE];
+parsed_command gc; // The command being done by process_commands()
 
 // Manage heater variables. For a thermistor or AD595 thermocouple, raw values refer to the 
 // reading from the analog pin. For a MAX6675 thermocouple, the raw value is the temperature in 0.25 
@@ -273,6 +290,8 @@ void setup()
   if(HEATER_0_PIN > -1) pinMode(HEATER_0_PIN,OUTPUT);
   if(HEATER_1_PIN > -1) pinMode(HEATER_1_PIN,OUTPUT);
   
+  setup_step_timer();
+
 #ifdef HEATER_USES_MAX6675
   digitalWrite(SCK_PIN,0);
   pinMode(SCK_PIN,OUTPUT);
@@ -306,13 +325,12 @@ void loop()
 {
 
 
-  if(buflen<3)
-	get_command();
+  get_command();
   
   if(buflen){
 #ifdef SDSUPPORT
     if(savetosd){
-        if(strstr(cmdbuffer[bufindr],"M29")==NULL){
+        if(!((parsed[bufindr].seen & CODE_M) && parsed[bufindr].M == 29)){
             write_command(cmdbuffer[bufindr]);
             file.sync();
             Serial.println("ok");
@@ -337,6 +355,57 @@ void loop()
 }
 
 
+// One pass along the line: note each word and its number, and XOR up the
+// checksum as we go.  Stops at the '*'.  A letter with no number after it
+// still counts as seen, with the value 0 (G28 X).  Everything after M23 or
+// M28 is a file name, so isn't looked at for words.
+
+void parse_command(char* cmd, parsed_command* p)
+{
+  char* end;
+  char c;
+  unsigned int flag;
+  bool filename = false;
+  
+  p->seen = 0;
+  p->line_checksum = 0;
+  
+  while((c = *cmd))
+  {
+    if(c == '*')
+    {
+      p->checksum = strtol(cmd+1, NULL, 10);
+      p->seen |= CODE_CHECKSUM;
+      return;
+    }
+    p->line_checksum ^= c;
+    cmd++;
+    if(filename)
+      continue;
+    end = cmd;
+    switch(c)
+    {
+      case 'G': p->G = strtol(cmd, &end, 10); flag = CODE_G; break;
+      case 'M': p->M = strtol(cmd, &end, 10); flag = CODE_M; break;
+      case 'T': p->T = strtol(cmd, &end, 10); flag = CODE_T; break;
+      case 'N': p->N = strtol(cmd, &end, 10); flag = CODE_N; break;
+      case 'X': p->X = decimal_to_float(cmd, &end); flag = CODE_X; break;
+      case 'Y': p->Y = decimal_to_float(cmd, &end); flag = CODE_Y; break;
+      case 'Z': p->Z = decimal_to_float(cmd, &end); flag = CODE_Z; break;
+      case 'E': p->E = decimal_to_float(cmd, &end); flag = CODE_E; break;
+      case 'F': p->F = decimal_to_float(cmd, &end); flag = CODE_F; break;
+      case 'S': p->S = decimal_to_float(cmd, &end); flag = CODE_S; break;
+      case 'P': p->P = decimal_to_float(cmd, &end); flag = CODE_P; break;
+      default: continue;
+    }
+    p->seen |= flag;
+    while(cmd < end)
+      p->line_checksum ^= *cmd++;
+    if(flag == CODE_M && (p->M == 23 || p->M == 28))
+      filename = true;
+  }
+}
+
 inline void get_command() 
 { 
   while( Serial.available() > 0  && buflen<BUFSIZE) {
@@ -347,27 +416,22 @@ inline void get_command()
       cmdbuffer[bufindw][serial_count] = 0; //terminate string
       if(!comment_mode){
     fromsd[bufindw]=false;
-  if(strstr(cmdbuffer[bufindw], "N") != NULL)
+    parsed_command* p = &parsed[bufindw];
+    parse_command(cmdbuffer[bufindw], p);
+  if(p->seen & CODE_N)
   {
-    strchr_pointer = strchr(cmdbuffer[bufindw], 'N');
-    gcode_N = (strtol(&cmdbuffer[bufindw][strchr_pointer - cmdbuffer[bufindw] + 1], NULL, 10));
-    if(gcode_N != gcode_LastN+1 && (strstr(cmdbuffer[bufindw], "M110") == NULL) ) {
+    if(p->N != gcode_LastN+1 && !((p->seen & CODE_M) && p->M == 110) ) {
       Serial.print("Serial Error: Line Number is not Last Line Number+1, Last Line:");
       Serial.println(gcode_LastN);
-      Serial.println(gcode_N);
+      Serial.println(p->N);
       FlushSerialRequestResend();
       serial_count = 0;
       return;
     } 
     
-    if(strstr(cmdbuffer[bufindw], "*") != NULL)
+    if(p->seen & CODE_CHECKSUM)
     {
-      byte checksum = 0;
-      byte count=0;
-      while(cmdbuffer[bufindw][count] != '*') checksum = checksum^cmdbuffer[bufindw][count++];
-      strchr_pointer = strchr(cmdbuffer[bufindw], '*');
-  
-      if( (int)(strtod(&cmdbuffer[bufindw][strchr_pointer - cmdbuffer[bufindw] + 1], NULL)) != checksum) {
+      if(p->checksum != p->line_checksum) {
         Serial.print("Error: checksum mismatch, Last Line:");
         Serial.println(gcode_LastN);
         FlushSerialRequestResend();
@@ -385,12 +449,12 @@ inline void get_command()
       return;
     }
     
-    gcode_LastN = gcode_N;
+    gcode_LastN = p->N;
     //if no errors, continue parsing
   }
   else  // if we don't receive 'N' but still see '*'
   {
-    if((strstr(cmdbuffer[bufindw], "*") != NULL))
+    if(p->seen & CODE_CHECKSUM)
     {
       Serial.print("Error: No Line Number with checksum, Last Line:");
       Serial.println(gcode_LastN);
@@ -398,9 +462,8 @@ inline void get_command()
       return;
     }
   }
-	if((strstr(cmdbuffer[bufindw], "G") != NULL)){
-		strchr_pointer = strchr(cmdbuffer[bufindw], 'G');
-		switch((int)((strtod(&cmdbuffer[bufindw][strchr_pointer - cmdbuffer[bufindw] + 1], NULL)))){
+	if(p->seen & CODE_G){
+		switch(p->G){
 		case 0:
 		case 1:
               #ifdef SDSUPPORT
@@ -445,6 +508,7 @@ if(!sdmode || serial_count!=0){
       cmdbuffer[bufindw][serial_count] = 0; //terminate string
       if(!comment_mode){
         fromsd[bufindw]=true;
+        parse_command(cmdbuffer[bufindw], &parsed[bufindw]);
         buflen+=1;
         bufindw=(bufindw+1)%BUFSIZE;
       }
@@ -462,18 +526,6 @@ if(!sdmode || serial_count!=0){
 }
 
 
-inline float code_value() { return (strtod(&cmdbuffer[bufindr][strchr_pointer - cmdbuffer[bufindr] + 1], NULL)); }
-inline long code_value_long() { return (strtol(&cmdbuffer[bufindr][strchr_pointer - cmdbuffer[bufindr] + 1], NULL, 10)); }
-inline bool code_seen(char code_string[]) { return (strstr(cmdbuffer[bufindr], code_string) != NULL); }  //Return True if the string was found
-
-inline bool code_seen(char code)
-{
-  strchr_pointer = strchr(cmdbuffer[bufindr], code);
-  return (strchr_pointer != NULL);  //Return True if a character was found
-}
- //experimental feedrate calc
-float d=0;
-float xdiff=0,ydiff=0,zdiff=0,ediff=0;
 
 
 
@@ -498,11 +550,8 @@ inline void home_x()
         else
           destination_x = 0.0; // Best we can do
   	setup_move();
-  	#ifdef REPRAP_ACC
-  	 linear_move();
-  	#else
-  	 linear_move(x_steps_to_take, y_steps_to_take, z_steps_to_take, e_steps_to_take); // make the move
-  	#endif
+  	linear_move();
+  	wait_for_moves();
   	current_x = 0;
   	current_feedrate = saved_feedrate;
 }
@@ -517,11 +566,8 @@ inline void home_y()
         else
           destination_y = 0.0; // Best we can do
   	setup_move();
-  	#ifdef REPRAP_ACC
-  	 linear_move();
-  	#else
-  	 linear_move(x_steps_to_take, y_steps_to_take, z_steps_to_take, e_steps_to_take); // make the move
-  	#endif
+  	linear_move();
+  	wait_for_moves();
   	current_y = 0;
   	current_feedrate = saved_feedrate;
 }
@@ -536,11 +582,8 @@ inline void home_z()
         else
           destination_z = 0.0; // Best we can do
   	setup_move();
-  	#ifdef REPRAP_ACC
-  	 linear_move();
-  	#else
-  	 linear_move(x_steps_to_take, y_steps_to_take, z_steps_to_take, e_steps_to_take); // make the move
-  	#endif  	
+  	linear_move();
+  	wait_for_moves();
   	current_z = 0;
   	current_feedrate = saved_feedrate;
  }
@@ -553,27 +596,25 @@ inline void process_commands()
   unsigned long codenum; //throw away variable
   char *starpos=NULL;
   boolean done;
-  if(code_seen('G'))
+  gc = parsed[bufindr];
+  if(gc.seen & CODE_G)
   {
-    switch((int)code_value())
+    switch(gc.G)
     {
       case 0: // G0 -> G1
       case 1: // G1
         get_coordinates(); // For X Y Z E F
         setup_move();
-#ifdef REPRAP_ACC
         linear_move();
-#else
-        linear_move(x_steps_to_take, y_steps_to_take, z_steps_to_take, e_steps_to_take); // make the move
-#endif
         previous_millis_cmd = millis();
         //ClearToSend();
         return;
         //break;
       case 4: // G4 dwell
         codenum = 0;
-        if(code_seen('P')) codenum = code_value(); // milliseconds to wait
-        if(code_seen('S')) codenum = code_value()*1000; // seconds to wait
+        if(gc.seen & CODE_P) codenum = gc.P; // milliseconds to wait
+        if(gc.seen & CODE_S) codenum = gc.S*1000; // seconds to wait
+        wait_for_moves();
         previous_millis_heater = millis();  // keep track of when we started waiting
         while((millis() - previous_millis_heater) < codenum ) manage_heater(); //manage heater until time is up
         break;
@@ -581,17 +622,17 @@ inline void process_commands()
         break;
       case 28: // Home axis or axes
         done = false;
-  	if(code_seen('X'))
+  	if(gc.seen & CODE_X)
   	{
   	  home_x();
   	  done = true;
   	}
-  	if(code_seen('Y'))
+  	if(gc.seen & CODE_Y)
   	{
   	  home_y();
   	  done = true;
   	}
-  	if(code_seen('Z'))
+  	if(gc.seen & CODE_Z)
   	{
   	  home_z();
   	  done = true;
@@ -611,19 +652,19 @@ inline void process_commands()
         relative_mode = true;
         break;
       case 92: // G92
-        if(code_seen('X')) current_x = code_value();
-        if(code_seen('Y')) current_y = code_value();
-        if(code_seen('Z')) current_z = code_value();
-        if(code_seen('E')) current_e = code_value();
+        if(gc.seen & CODE_X) current_x = gc.X;
+        if(gc.seen & CODE_Y) current_y = gc.Y;
+        if(gc.seen & CODE_Z) current_z = gc.Z;
+        if(gc.seen & CODE_E) current_e = gc.E;
         break;
         
     }
   }
 
-  else if(code_seen('M'))
+  else if(gc.seen & CODE_M)
   {
     
-    switch( (int)code_value() ) 
+    switch(gc.M) 
     {
       case 0:
         Serial.println("ok"); // Next call never returns...
@@ -647,6 +688,7 @@ inline void process_commands()
         break;
       case 23: //M23 - Select file
         if(sdactive){
+            strchr_pointer = strchr(cmdbuffer[bufindr], 'M');
             sdmode=false;
             file.close();
             starpos=(strchr(strchr_pointer+4,'*'));
@@ -677,8 +719,9 @@ inline void process_commands()
         }
         break;
       case 26: //M26 - Set SD index
-        if(sdactive && code_seen('S')){
-            sdpos=code_value_long();
+        if(sdactive && (gc.seen & CODE_S)){
+            strchr_pointer = strchr(cmdbuffer[bufindr], 'S');
+            sdpos=strtol(strchr_pointer+1, NULL, 10); // Too big for a float
             file.seekSet(sdpos);
         }
         break;
@@ -694,6 +737,7 @@ inline void process_commands()
         break;
       case 28: //M28 - Start SD write
         if(sdactive){
+            strchr_pointer = strchr(cmdbuffer[bufindr], 'M');
           char* npos=0;
             file.close();
             sdmode=false;
@@ -721,7 +765,8 @@ inline void process_commands()
         break;
 #endif
       case 104: // M104
-        if (code_seen('S')) target_raw = temp2analog(code_value());
+        wait_for_moves();
+        if (gc.seen & CODE_S) target_raw = temp2analog(gc.S);
         #ifdef WATCHPERIOD
             if(target_raw>current_raw){
                 watchmillis=max(1,millis());
@@ -732,7 +777,8 @@ inline void process_commands()
         #endif
         break;
       case 140: // M140 set bed temp
-        if (code_seen('S')) target_bed_raw = temp2analogBed(code_value());
+        wait_for_moves();
+        if (gc.seen & CODE_S) target_bed_raw = temp2analogBed(gc.S);
         break;
       case 105: // M105
         #if (TEMP_0_PIN>-1) || defined (HEATER_USES_MAX6675)
@@ -755,7 +801,8 @@ inline void process_commands()
         return;
         //break;
       case 109: // M109 - Wait for extruder heater to reach target.
-        if (code_seen('S')) target_raw = temp2analog(code_value());
+        wait_for_moves();
+        if (gc.seen & CODE_S) target_raw = temp2analog(gc.S);
         #ifdef WATCHPERIOD
             if(target_raw>current_raw){
                 watchmillis=max(1,millis());
@@ -780,7 +827,8 @@ inline void process_commands()
         break;
       case 190: // M190 - Wait bed for heater to reach target.
       #if TEMP_1_PIN>-1
-        if (code_seen('S')) target_bed_raw = temp2analog(code_value());
+        wait_for_moves();
+        if (gc.seen & CODE_S) target_bed_raw = temp2analog(gc.S);
         previous_millis_heater = millis(); 
         while(current_bed_raw < target_bed_raw) {
           if( (millis()-previous_millis_heater) > 1000 ) //Print Temp Reading every 1 second while heating up.
@@ -799,22 +847,26 @@ inline void process_commands()
       #endif
       break;
       case 106: //M106 Fan On
-        if (code_seen('S')){
+        wait_for_moves();
+        if (gc.seen & CODE_S){
             digitalWrite(FAN_PIN, HIGH);
-            analogWrite(FAN_PIN,constrain(code_value(),0,255));
+            analogWrite(FAN_PIN,constrain(gc.S,0,255));
         }
         else
             digitalWrite(FAN_PIN, HIGH);
         break;
       case 107: //M107 Fan Off
+        wait_for_moves();
         analogWrite(FAN_PIN, 0);
         
         digitalWrite(FAN_PIN, LOW);
         break;
       case 80: // M81 - ATX Power On
+        wait_for_moves();
         if(PS_ON_PIN > -1) pinMode(PS_ON_PIN,OUTPUT); //GND
         break;
       case 81: // M81 - ATX Power Off
+        wait_for_moves();
         if(PS_ON_PIN > -1) pinMode(PS_ON_PIN,INPUT); //Floating
         break;
       case 82:
@@ -824,24 +876,25 @@ inline void process_commands()
         relative_mode_e = true;
         break;
       case 84:
+        wait_for_moves();
         disable_x();
         disable_y();
         disable_z();
         disable_e();
         break;
       case 85: // M85
-        code_seen('S');
-        max_inactive_time = code_value()*1000; 
+        max_inactive_time = (gc.seen & CODE_S) ? gc.S*1000 : 0; 
         break;
       case 86: // M86 If Endstop is Not Activated then Abort Print
-        if(code_seen('X')) if( digitalRead(X_MIN_PIN) == ENDSTOPS_INVERTING ) kill(3);
-        if(code_seen('Y')) if( digitalRead(Y_MIN_PIN) == ENDSTOPS_INVERTING ) kill(4);
+        wait_for_moves();
+        if(gc.seen & CODE_X) if( digitalRead(X_MIN_PIN) == ENDSTOPS_INVERTING ) kill(3);
+        if(gc.seen & CODE_Y) if( digitalRead(Y_MIN_PIN) == ENDSTOPS_INVERTING ) kill(4);
         break;
       case 92: // M92
-        if(code_seen('X')) x_steps_per_unit = code_value();
-        if(code_seen('Y')) y_steps_per_unit = code_value();
-        if(code_seen('Z')) z_steps_per_unit = code_value();
-        if(code_seen('E')) e_steps_per_unit = code_value();
+        if(gc.seen & CODE_X) x_steps_per_unit = gc.X;
+        if(gc.seen & CODE_Y) y_steps_per_unit = gc.Y;
+        if(gc.seen & CODE_Z) z_steps_per_unit = gc.Z;
+        if(gc.seen & CODE_E) e_steps_per_unit = gc.E;
         break;
       case 115: // M115
         Serial.println("FIRMWARE_NAME:Sprinter FIRMWARE_URL:http%%3A/github.com/kliment/Sprinter/ PROTOCOL_VERSION:1.0 MACHINE_TYPE:Mendel EXTRUDER_COUNT:1");
@@ -860,7 +913,7 @@ inline void process_commands()
     }
     
   }
-  else if(code_seen('T'))
+  else if(gc.seen & CODE_T)
   {
      // Put some extruder-swapping code in here... 
   }
@@ -895,13 +948,13 @@ inline void ClearToSend()
 inline void get_coordinates()
 {
   current_to_dest();
-  if(code_seen('X')) destination_x = (float)code_value() + relative_mode*current_x;
-  if(code_seen('Y')) destination_y = (float)code_value() + relative_mode*current_y;
-  if(code_seen('Z')) destination_z = (float)code_value() + relative_mode*current_z;
-  if(code_seen('E')) destination_e = (float)code_value() + (relative_mode_e || relative_mode)*current_e;
-  if(code_seen('F')) {
+  if(gc.seen & CODE_X) destination_x = (float)gc.X + relative_mode*current_x;
+  if(gc.seen & CODE_Y) destination_y = (float)gc.Y + relative_mode*current_y;
+  if(gc.seen & CODE_Z) destination_z = (float)gc.Z + relative_mode*current_z;
+  if(gc.seen & CODE_E) destination_e = (float)gc.E + (relative_mode_e || relative_mode)*current_e;
+  if(gc.seen & CODE_F) {
     current_feedrate = feedrate;
-    next_feedrate = code_value();
+    next_feedrate = gc.F;
     if(next_feedrate > 0.0) feedrate = next_feedrate;
   }
   
@@ -912,14 +965,16 @@ inline void get_coordinates()
 
 
 
-inline void disable_x() { if(X_ENABLE_PIN > -1) digitalWrite(X_ENABLE_PIN,!X_ENABLE_ON); }
-inline void disable_y() { if(Y_ENABLE_PIN > -1) digitalWrite(Y_ENABLE_PIN,!Y_ENABLE_ON); }
-inline void disable_z() { if(Z_ENABLE_PIN > -1) digitalWrite(Z_ENABLE_PIN,!Z_ENABLE_ON); }
-inline void disable_e() { if(E_ENABLE_PIN > -1) digitalWrite(E_ENABLE_PIN,!E_ENABLE_ON); }
-inline void  enable_x() { if(X_ENABLE_PIN > -1) digitalWrite(X_ENABLE_PIN, X_ENABLE_ON); }
-inline void  enable_y() { if(Y_ENABLE_PIN > -1) digitalWrite(Y_ENABLE_PIN, Y_ENABLE_ON); }
-inline void  enable_z() { if(Z_ENABLE_PIN > -1) digitalWrite(Z_ENABLE_PIN, Z_ENABLE_ON); }
-inline void  enable_e() { if(E_ENABLE_PIN > -1) digitalWrite(E_ENABLE_PIN, E_ENABLE_ON); }
+// The step interrupt calls these, so no digitalWrite()
+
+inline void disable_x() { if(X_ENABLE_PIN > -1) fastDigitalWrite(X_ENABLE_PIN,!X_ENABLE_ON); }
+inline void disable_y() { if(Y_ENABLE_PIN > -1) fastDigitalWrite(Y_ENABLE_PIN,!Y_ENABLE_ON); }
+inline void disable_z() { if(Z_ENABLE_PIN > -1) fastDigitalWrite(Z_ENABLE_PIN,!Z_ENABLE_ON); }
+inline void disable_e() { if(E_ENABLE_PIN > -1) fastDigitalWrite(E_ENABLE_PIN,!E_ENABLE_ON); }
+inline void  enable_x() { if(X_ENABLE_PIN > -1) fastDigitalWrite(X_ENABLE_PIN, X_ENABLE_ON); }
+inline void  enable_y() { if(Y_ENABLE_PIN > -1) fastDigitalWrite(Y_ENABLE_PIN, Y_ENABLE_ON); }
+inline void  enable_z() { if(Z_ENABLE_PIN > -1) fastDigitalWrite(Z_ENABLE_PIN, Z_ENABLE_ON); }
+inline void  enable_e() { if(E_ENABLE_PIN > -1) fastDigitalWrite(E_ENABLE_PIN, E_ENABLE_ON); }
 
 #define HEAT_INTERVAL 250
 #ifdef HEATER_USES_MAX6675
@@ -1197,6 +1252,7 @@ inline void kill(byte debug)
   if(HEATER_0_PIN > -1) digitalWrite(HEATER_0_PIN,LOW);
   if(HEATER_1_PIN > -1) digitalWrite(HEATER_1_PIN,LOW);
   
+  TIMSK1 &= ~(1<<OCIE1A); // Stop stepping
   disable_x();
   disable_y();
   disable_z();
@@ -1225,9 +1281,7 @@ inline void manage_inactivity(byte debug) { if( (millis()-previous_millis_cmd) >
 
 // ************************************************************************************************************************************
 
-// Code for RepRap-style accelerations
-
-#ifdef REPRAP_ACC
+// Code for moves
 
 // The number of mm below which distances are insignificant (one tenth the
 // resolution of the machine is the default value).
@@ -1235,63 +1289,132 @@ inline void manage_inactivity(byte debug) { if( (millis()-previous_millis_cmd) >
 // Useful to have its square
 #define SMALL_DISTANCE2 (SMALL_DISTANCE*SMALL_DISTANCE)
 
-bool nullmove, real_move;
+bool nullmove;
 bool direction_f;
-bool x_can_step, y_can_step, z_can_step, e_can_step, f_can_step;
 long total_steps, t_scale;
-long dda_counter_x, dda_counter_y, dda_counter_z, dda_counter_e, dda_counter_f;
 long current_steps_x, current_steps_y, current_steps_z, current_steps_e, current_steps_f;
 long target_steps_x, target_steps_y, target_steps_z, target_steps_e, target_steps_f;
-long delta_steps_x, delta_steps_y, delta_steps_z, delta_steps_e, delta_steps_f;	
+long delta_steps_x, delta_steps_y, delta_steps_z, delta_steps_e, delta_steps_f;
 float position, target, diff, distance;
-long integer_distance;
-long step_time, time_increment;
+#ifndef REPRAP_ACC
+long accelerate_until, decelerate_after; // The speed profile linear_move() works out
+unsigned long initial_rate, nominal_rate;
+unsigned int acceleration_rate;
+#endif
 
 /*
 
-Calculate delay between steps in microseconds.  Here it is in English:
+Moves are not stepped out here.  setup_move() works out the steps for a move,
+queue_move() copies them into a block at the head of the ring below and returns,
+and the TIMER1 compare interrupt does the DDA for the block at the tail.  So
+loop() carries on reading and parsing commands while the machine moves, and
+the next move is ready to go the moment the current one finishes.
 
-60000000.0*distance/feedrate_now  = move duration in microseconds
-move duration/total_steps = time between steps for master axis.
+current_x etc. are therefore where the machine will be when the queue
+empties, not where it is now.  Anything that needs the machine to be
+still (homing, dwell, M84...) calls wait_for_moves() first, and so does
+anything that has to happen between two moves rather than during the
+one before it (heaters, fan, power).
+
+*/
+
+#define BLOCK_BUFFER_SIZE 16 // Must be a power of 2
+#define BLOCK_BUFFER_MASK (BLOCK_BUFFER_SIZE - 1)
+
+struct move_block
+{
+  long delta_steps_x, delta_steps_y, delta_steps_z, delta_steps_e, delta_steps_f;
+  long total_steps;
+#ifdef REPRAP_ACC
+  unsigned long initial_f, rate_step, fast_f; // F steps at the start, DDA ticks a second <<16 per F step, and the F too fast for that
+#else
+  unsigned long initial_rate, nominal_rate; // DDA ticks a second <<16 at the ends and in the middle...
+  unsigned int acceleration_rate;           // ...and its change per timer tick
+  long accelerate_until, decelerate_after;  // DDA tick at which to stop speeding up, and after which to slow down
+#endif
+  bool direction_x, direction_y, direction_z, direction_e, direction_f;
+};
+
+move_block block_buffer[BLOCK_BUFFER_SIZE];
+volatile byte block_head = 0; // Written by queue_move()
+volatile byte block_tail = 0; // Written by the interrupt when a block is finished
+
+// Only touched by the interrupt
+
+move_block* dda_block = NULL;
+bool x_can_step, y_can_step, z_can_step, e_can_step, f_can_step;
+long dda_counter_x, dda_counter_y, dda_counter_z, dda_counter_e, dda_counter_f;
+long dda_left_x, dda_left_y, dda_left_z, dda_left_e, dda_left_f;
+unsigned long dda_ticks;
+#ifdef REPRAP_ACC
+unsigned long dda_f;
+#else
+unsigned long dda_rate;
+long dda_tick_count;
+#endif
+unsigned long step_wait;
+
+// TIMER1 runs at clk/8 in CTC mode; OCR1A is the time to the next DDA tick
+
+#define IDLE_TICKS 200
+
+// Ticks where only F changes don't wait for the timer, but after this many
+// in a row the interrupt lets everything else in before it carries on
+
+#define MAX_F_TICKS 8
+
+/*
+
+The time between DDA ticks.  Here it is in English:
+
+60.0*distance/feedrate_now  = move duration in seconds
+total_steps/move duration = DDA ticks a second
 
 feedrate_now is in mm/minute, 
-distance is in mm, 
-integer_distance is 3000000.0*distance
+distance is in mm.
 
-To prevent long overflow, we work in increments of 20 microseconds; hence 
-the 3,000,000 rather than 60,000,000.
-*/
+So the rate goes up and down in proportion to feedrate_now.  queue_move()
+works out the rate for each F step, and the interrupt keeps F (dda_f) and
+turns it into the rate with f_to_rate() and the rate into the timer count
+with rate_to_ticks() (both in feedrate_ramp.h) whenever F changes.
 
-#define DISTANCE_MULTIPLIER 3000000.0
-#define MICRO_RES 20
+Without REPRAP_ACC there's no F axis; linear_move() works out the rates at
+the ends and in the middle of the move and the acceleration between them,
+and the interrupt keeps the rate (dda_rate) itself.
+*/
 
-inline long calculate_feedrate_delay(const long& feedrate_now)
-{  
-  return MICRO_RES*(integer_distance/(feedrate_now*total_steps));	
-}
+// The do_?_step()s start the step pulses; end_steps() finishes them at the
+// end of the interrupt, at least STEP_PULSE_US later.
 
 inline void do_x_step()
 {
-  digitalWrite(X_STEP_PIN, HIGH);
-  digitalWrite(X_STEP_PIN, LOW);
+  fastDigitalWrite(X_STEP_PIN, HIGH);
 }
 
 inline void do_y_step()
 {
-  digitalWrite(Y_STEP_PIN, HIGH);
-  digitalWrite(Y_STEP_PIN, LOW);
+  fastDigitalWrite(Y_STEP_PIN, HIGH);
 }
 
 inline void do_z_step()
 {
-  digitalWrite(Z_STEP_PIN, HIGH);
-  digitalWrite(Z_STEP_PIN, LOW);
+  fastDigitalWrite(Z_STEP_PIN, HIGH);
 }
 
 inline void do_e_step()
 {
-  digitalWrite(E_STEP_PIN, HIGH);
-  digitalWrite(E_STEP_PIN, LOW);
+  fastDigitalWrite(E_STEP_PIN, HIGH);
+}
+
+inline void end_steps()
+{
+#if STEP_PULSE_US > 0
+  _delay_us(STEP_PULSE_US);
+#endif
+  fastDigitalWrite(X_STEP_PIN, LOW);
+  fastDigitalWrite(Y_STEP_PIN, LOW);
+  fastDigitalWrite(Z_STEP_PIN, LOW);
+  fastDigitalWrite(E_STEP_PIN, LOW);
 }
 
 #define ALWAYS_UPDATE 1
@@ -1367,11 +1490,14 @@ inline void setup_move()
     return; 
   }    
  
+#ifdef REPRAP_ACC
   coord_to_steps(current_feedrate, feedrate, current_steps_f, f_steps_per_unit,
               target_steps_f, delta_steps_f, direction_f, NEVER_UPDATE);  
+#else
+  delta_steps_f = 0; // linear_move() does the speed
+#endif
 
   distance = sqrt(distance); 
-  integer_distance = lround(distance*DISTANCE_MULTIPLIER);  
                                                                                    		
   total_steps = max(delta_steps_x, delta_steps_y);
   total_steps = max(total_steps, delta_steps_z);
@@ -1386,6 +1512,7 @@ inline void setup_move()
      return;
   }    
   
+#ifdef REPRAP_ACC
   // Rescale the feedrate so it doesn't take lots of steps to do
     
   t_scale = 1;
@@ -1396,6 +1523,8 @@ inline void setup_move()
      {
        target_steps_f = target_steps_f/t_scale;
        current_steps_f = current_steps_f/t_scale;
+       if(target_steps_f < 1) target_steps_f = 1; // Never a zero feedrate
+       if(current_steps_f < 1) current_steps_f = 1;
        delta_steps_f = abs(target_steps_f - current_steps_f);
        if(delta_steps_f > total_steps)
           total_steps =  delta_steps_f;
@@ -1404,557 +1533,406 @@ inline void setup_move()
        t_scale = 1;
        total_steps =  delta_steps_f;
      }
-  }  
+  }
+#endif
+}
 
-  dda_counter_x = -total_steps/2;
-  dda_counter_y = dda_counter_x;
-  dda_counter_z = dda_counter_x;
-  dda_counter_e = dda_counter_x;
-  dda_counter_f = dda_counter_x;
-  
-  time_increment = calculate_feedrate_delay(t_scale*current_steps_f);
+// True if there's no endstop on pin, or it isn't hit.  fastDigitalRead() needs
+// the pin to be a constant, so the endstops are read where can_step_switch() is called.
+
+#define ENDSTOP_CLEAR(pin) ((pin) < 0 || fastDigitalRead(pin) == ENDSTOPS_INVERTING)
 
-  if(delta_steps_x) enable_x();
-  if(delta_steps_y) enable_y();
-  if(delta_steps_z) enable_z();
-  if(delta_steps_e) enable_e();
+inline bool can_step_switch(const long& steps_left, bool direction, bool min_clear, bool max_clear)
+{
+  if(!steps_left)
+    return false;
   
-  if (direction_x) digitalWrite(X_DIR_PIN,!INVERT_X_DIR);
-  else digitalWrite(X_DIR_PIN,INVERT_X_DIR);
-  if (direction_y) digitalWrite(Y_DIR_PIN,!INVERT_Y_DIR);
-  else digitalWrite(Y_DIR_PIN,INVERT_Y_DIR);
-  if (direction_z) digitalWrite(Z_DIR_PIN,!INVERT_Z_DIR);
-  else digitalWrite(Z_DIR_PIN,INVERT_Z_DIR);
-  if (direction_e) digitalWrite(E_DIR_PIN,!INVERT_E_DIR);
-  else digitalWrite(E_DIR_PIN,INVERT_E_DIR); 
+  return direction ? max_clear : min_clear;
+}
 
+inline bool can_step(const long& steps_left)
+{
+   return steps_left != 0;
 }
 
-inline bool can_step_switch(const long& here, const long& there, bool direction, int minstop, int maxstop)
+inline bool moves_queued()
 {
-  if(here == there)
-    return false;
-  
-  if(direction)
+  return block_head != block_tail;
+}
+
+// Set the time to the next interrupt.  Waits too long for the 16-bit
+// timer are done in laps of 32768 ticks.
+
+inline void set_step_timer(unsigned long ticks)
+{
+  if(ticks > 65535)
   {
-      if(maxstop >= 0)
-        return digitalRead(maxstop) == ENDSTOPS_INVERTING;
+    step_wait = ticks - 32768;
+    OCR1A = 32768;
   } else
   {
-      if(minstop >= 0)
-        return digitalRead(minstop) == ENDSTOPS_INVERTING;
+    step_wait = 0;
+    OCR1A = ticks;
   }
+}
+
+#ifndef REPRAP_ACC
+
+// The change in rate since the last DDA tick.  Only slow ticks are longer
+// than 16 bits, and they have time for a division to stop it overflowing.
+
+inline unsigned long rate_change()
+{
+  if(dda_ticks > 65535 && dda_block->acceleration_rate > 0xffffffffUL/dda_ticks)
+    return 0xffffffffUL;
+  return dda_block->acceleration_rate*dda_ticks;
+}
+
+#endif
+
+inline void start_block(move_block* b)
+{
+  dda_block = b;
   
-  return true;
+  dda_counter_x = -b->total_steps/2;
+  dda_counter_y = dda_counter_x;
+  dda_counter_z = dda_counter_x;
+  dda_counter_e = dda_counter_x;
+  dda_counter_f = dda_counter_x;
+  
+  dda_left_x = b->delta_steps_x;
+  dda_left_y = b->delta_steps_y;
+  dda_left_z = b->delta_steps_z;
+  dda_left_e = b->delta_steps_e;
+  dda_left_f = b->delta_steps_f;
+#ifdef REPRAP_ACC
+  dda_f = b->initial_f;
+  dda_ticks = rate_to_ticks(f_to_rate(dda_f, b->rate_step, b->fast_f));
+#else
+  dda_rate = b->initial_rate;
+  dda_tick_count = 0;
+  dda_ticks = rate_to_ticks(dda_rate);
+#endif
+
+  if(dda_left_x) enable_x();
+  if(dda_left_y) enable_y();
+  if(dda_left_z) enable_z();
+  if(dda_left_e) enable_e();
+  
+  if (b->direction_x) fastDigitalWrite(X_DIR_PIN,!INVERT_X_DIR);
+  else fastDigitalWrite(X_DIR_PIN,INVERT_X_DIR);
+  if (b->direction_y) fastDigitalWrite(Y_DIR_PIN,!INVERT_Y_DIR);
+  else fastDigitalWrite(Y_DIR_PIN,INVERT_Y_DIR);
+  if (b->direction_z) fastDigitalWrite(Z_DIR_PIN,!INVERT_Z_DIR);
+  else fastDigitalWrite(Z_DIR_PIN,INVERT_Z_DIR);
+  if (b->direction_e) fastDigitalWrite(E_DIR_PIN,!INVERT_E_DIR);
+  else fastDigitalWrite(E_DIR_PIN,INVERT_E_DIR); 
 }
 
-inline bool can_step(const long& here, const long& there)
+inline void finish_block()
 {
-   return here != there;
+  if(DISABLE_X) disable_x();
+  if(DISABLE_Y) disable_y();
+  if(DISABLE_Z) disable_z();
+  if(DISABLE_E) disable_e();
+  
+  dda_block = NULL;
+  block_tail = (block_tail + 1) & BLOCK_BUFFER_MASK;
 }
 
-void linear_move() // make linear move with preset speeds and destinations, see G0 and G1
+// One DDA tick per interrupt.  Ticks where only F changes don't wait
+// for the timer (up to MAX_F_TICKS of them).
+
+ISR(TIMER1_COMPA_vect)
 {
-   if(nullmove)
-   {
-     nullmove = false;
-     return;
-   }
-   
-  step_time = micros();
- 
+  if(step_wait)
+  {
+    set_step_timer(step_wait);
+    return;
+  }
+  
+  bool real_move = false;
+  byte f_ticks = 0;
+  
   do
   {
-      while(step_time > micros())
+    if(!dda_block)
+    {
+      if(!moves_queued())
       {
-        if((millis() - previous_millis_heater) >= 500)
-        {
-          manage_heater();
-          previous_millis_heater = millis();
-          manage_inactivity(2);
-        }
+        set_step_timer(IDLE_TICKS);
+        TIMSK1 &= ~(1<<OCIE1A);
+        return;
       }
-      
-                x_can_step = can_step_switch(current_steps_x, target_steps_x, direction_x, X_MIN_PIN, X_MAX_PIN);
-		y_can_step = can_step_switch(current_steps_y, target_steps_y, direction_y, Y_MIN_PIN, Y_MAX_PIN);
-                z_can_step = can_step_switch(current_steps_z, target_steps_z, direction_z, Z_MIN_PIN, Z_MAX_PIN);
-                e_can_step = can_step(current_steps_e, target_steps_e);
-                f_can_step = can_step(current_steps_f, target_steps_f);
+      start_block(&block_buffer[block_tail]);
+    }
+    
+                x_can_step = can_step_switch(dda_left_x, dda_block->direction_x, ENDSTOP_CLEAR(X_MIN_PIN), ENDSTOP_CLEAR(X_MAX_PIN));
+		y_can_step = can_step_switch(dda_left_y, dda_block->direction_y, ENDSTOP_CLEAR(Y_MIN_PIN), ENDSTOP_CLEAR(Y_MAX_PIN));
+                z_can_step = can_step_switch(dda_left_z, dda_block->direction_z, ENDSTOP_CLEAR(Z_MIN_PIN), ENDSTOP_CLEAR(Z_MAX_PIN));
+                e_can_step = can_step(dda_left_e);
+                f_can_step = can_step(dda_left_f);
                 
-                real_move = false;
+                if(!(x_can_step || y_can_step || z_can_step  || e_can_step || f_can_step))
+                {
+                  finish_block();
+                  continue;
+                }
                 
 		if (x_can_step)
 		{
-			dda_counter_x += delta_steps_x;
+			dda_counter_x += dda_block->delta_steps_x;
 			
 			if (dda_counter_x > 0)
 			{
 				do_x_step();
                                 real_move = true;
-				dda_counter_x -= total_steps;
-				
-				if (direction_x)
-					current_steps_x++;
-				else
-					current_steps_x--;
+				dda_counter_x -= dda_block->total_steps;
+				dda_left_x--;
 			}
 		}
 
 		if (y_can_step)
 		{
-			dda_counter_y += delta_steps_y;
+			dda_counter_y += dda_block->delta_steps_y;
 			
 			if (dda_counter_y > 0)
 			{
 				do_y_step();
                                 real_move = true;
-				dda_counter_y -= total_steps;
-
-				if (direction_y)
-					current_steps_y++;
-				else
-					current_steps_y--;
+				dda_counter_y -= dda_block->total_steps;
+				dda_left_y--;
 			}
 		}
 		
 		if (z_can_step)
 		{
-			dda_counter_z += delta_steps_z;
+			dda_counter_z += dda_block->delta_steps_z;
 			
 			if (dda_counter_z > 0)
 			{
 				do_z_step();
                                 real_move = true;
-				dda_counter_z -= total_steps;
-				
-				if (direction_z)
-					current_steps_z++;
-				else
-					current_steps_z--;
+				dda_counter_z -= dda_block->total_steps;
+				dda_left_z--;
 			}
 		}
 
 		if (e_can_step)
 		{
-			dda_counter_e += delta_steps_e;
+			dda_counter_e += dda_block->delta_steps_e;
 			
 			if (dda_counter_e > 0)
 			{
-                                
 				do_e_step();
                                 real_move = true;
-				dda_counter_e -= total_steps;
-				
-				if (direction_e)
-					current_steps_e++;
-				else
-					current_steps_e--;
+				dda_counter_e -= dda_block->total_steps;
+				dda_left_e--;
 			}
 		}
 		
+#ifdef REPRAP_ACC
 		if (f_can_step)
 		{
-			dda_counter_f += delta_steps_f;
+			dda_counter_f += dda_block->delta_steps_f;
 			
 			if (dda_counter_f > 0)
 			{
-				dda_counter_f -= total_steps;
-				if (direction_f)
-					current_steps_f++;
+				dda_counter_f -= dda_block->total_steps;
+				dda_left_f--;
+				if (dda_block->direction_f)
+					dda_f++;
 				else
-					current_steps_f--;
-                                time_increment = calculate_feedrate_delay(t_scale*current_steps_f);
+					dda_f--;
+				dda_ticks = rate_to_ticks(f_to_rate(dda_f, dda_block->rate_step, dda_block->fast_f));
 			} 
 		}
+#else
+		// Follow the trapezoid linear_move() worked out.  The rate changes by
+		// the acceleration times the time since the last tick.
+
+		dda_tick_count++;
+		if (dda_tick_count <= dda_block->accelerate_until)
+		{
+			unsigned long dv = rate_change();
+			if (dda_rate < dda_block->nominal_rate && dda_block->nominal_rate - dda_rate > dv)
+				dda_rate += dv;
+			else
+				dda_rate = dda_block->nominal_rate;
+			dda_ticks = rate_to_ticks(dda_rate);
+		} else if (dda_tick_count > dda_block->decelerate_after)
+		{
+			unsigned long dv = rate_change();
+			if (dda_rate > dda_block->initial_rate && dda_rate - dda_block->initial_rate > dv)
+				dda_rate -= dv;
+			else
+				dda_rate = dda_block->initial_rate;
+			dda_ticks = rate_to_ticks(dda_rate);
+		} else if (dda_rate != dda_block->nominal_rate)
+		{
+			// Cruise at exactly the right speed, even if we didn't quite get there
+			
+			dda_rate = dda_block->nominal_rate;
+			dda_ticks = rate_to_ticks(dda_rate);
+		}
+#endif
                   
-                if(real_move) // If only F has changed, no point in delaying 
-                  step_time += time_increment; 
-                  
-  } while (x_can_step || y_can_step || z_can_step  || e_can_step || f_can_step);
+  } while(!real_move && ++f_ticks < MAX_F_TICKS); // If only F has changed, no point in delaying
   
+  if(!real_move)
+  {
+    // Come back as soon as anything waiting has had its turn
+    set_step_timer(TCNT1 + IDLE_TICKS);
+    return;
+  }
+  
+  end_steps();
+  set_step_timer(dda_ticks);
+}
 
-  if(DISABLE_X) disable_x();
-  if(DISABLE_Y) disable_y();
-  if(DISABLE_Z) disable_z();
-  if(DISABLE_E) disable_e();
+void setup_step_timer()
+{
+  TCCR1A = 0;
+  TCCR1B = (1<<WGM12) | (1<<CS11); // CTC, clk/8
+  set_step_timer(IDLE_TICKS);
+  TIMSK1 &= ~(1<<OCIE1A);
+}
 
-  if(digitalRead(X_MIN_PIN) != ENDSTOPS_INVERTING)
-    current_x = 0.0;
-  else
-    current_x = destination_x;
-  if(digitalRead(Y_MIN_PIN) != ENDSTOPS_INVERTING)
-    current_y = 0.0;
-  else
-    current_y = destination_y;
-  if(digitalRead(Z_MIN_PIN) != ENDSTOPS_INVERTING)
-    current_z = 0.0;
-  else
-    current_z = destination_z;    
+void wait_for_moves()
+{
+  while(moves_queued())
+  {
+    manage_heater();
+    manage_inactivity(1);
+  }
+}
+
+void queue_move() // queue a linear move with preset speeds and destinations
+{
+   if(nullmove)
+   {
+     nullmove = false;
+     return;
+   }
+   
+  byte next_head = (block_head + 1) & BLOCK_BUFFER_MASK;
+  while(next_head == block_tail) // Queue full
+  {
+    manage_heater();
+    manage_inactivity(2);
+  }
+  
+  move_block* b = &block_buffer[block_head];
+  b->delta_steps_x = delta_steps_x;
+  b->delta_steps_y = delta_steps_y;
+  b->delta_steps_z = delta_steps_z;
+  b->delta_steps_e = delta_steps_e;
+  b->delta_steps_f = delta_steps_f;
+  b->direction_x = direction_x;
+  b->direction_y = direction_y;
+  b->direction_z = direction_z;
+  b->direction_e = direction_e;
+  b->direction_f = direction_f;
+  b->total_steps = total_steps;
+#ifdef REPRAP_ACC
+  b->initial_f = current_steps_f;
+  b->rate_step = max(lround(65536.0*t_scale*total_steps/(60.0*distance)), 1);
+  b->fast_f = MAX_DDA_RATE/b->rate_step;
+#else
+  b->initial_rate = initial_rate;
+  b->nominal_rate = nominal_rate;
+  b->acceleration_rate = acceleration_rate;
+  b->accelerate_until = accelerate_until;
+  b->decelerate_after = decelerate_after;
+#endif
+  
+  block_head = next_head;
+  TIMSK1 |= (1<<OCIE1A);
 
+  current_x = destination_x;
+  current_y = destination_y;
+  current_z = destination_z;
   current_e = destination_e;
   current_feedrate = feedrate;
 
 }
 
-#else
-
-//******************************************************************************************************************
+#ifdef REPRAP_ACC
 
-// Code for ordinary G-Code F behaviour
+// RepRap-style: the feedrate goes from the last F to this one over the move
 
-inline void do_x_step()
+void linear_move() // see G0 and G1
 {
-  digitalWrite(X_STEP_PIN, HIGH);
-  previous_micros_x += interval;
-  //delayMicroseconds(3);
-  digitalWrite(X_STEP_PIN, LOW);
+  queue_move();
 }
 
-inline void do_y_step()
-{
-  digitalWrite(Y_STEP_PIN, HIGH);
-  previous_micros_y += interval;
-  //delayMicroseconds(3);
-  digitalWrite(Y_STEP_PIN, LOW);
-}
+#else
 
-inline void do_z_step()
-{
-  digitalWrite(Z_STEP_PIN, HIGH);
-  previous_micros_z += z_interval;
-  //delayMicroseconds(3);
-  digitalWrite(Z_STEP_PIN, LOW);
-}
+//******************************************************************************************************************
 
-inline void do_e_step()
-{
-  digitalWrite(E_STEP_PIN, HIGH);
-  previous_micros_e += e_interval;
-  //delayMicroseconds(3);
-  digitalWrite(E_STEP_PIN, LOW);
-}
+// Ordinary G-Code F behaviour.  Each move is one block that speeds up at a
+// constant acceleration from min_units_per_second to F, runs at F, and slows
+// back down at the same acceleration.  The acceleration is the one that gets
+// to F in full_velocity_units (travel_move_full_velocity_units if E doesn't
+// move).  Moves too short for both ramps and min_constant_speed_units at F
+// don't get up to F; moves shorter than min_constant_speed_units are done at
+// the slower of F and min_units_per_second.
+//
+// It's all worked out here in DDA ticks along the longest axis, and the
+// interrupt does the ramps in whole numbers (see queue_move() and the ISR).
 
+// DDA ticks a second to the interrupt's rate (see feedrate_ramp.h)
 
-inline void setup_move()
+inline unsigned long to_dda_rate(float ticks_per_second)
 {
-    //Find direction
-  if(destination_x >= current_x) direction_x=1;
-  else direction_x=0;
-  if(destination_y >= current_y) direction_y=1;
-  else direction_y=0;
-  if(destination_z >= current_z) direction_z=1;
-  else direction_z=0;
-  if(destination_e >= current_e) direction_e=1;
-  else direction_e=0;
-  
-  
-  if (min_software_endstops) {
-    if (destination_x < 0) destination_x = 0.0;
-    if (destination_y < 0) destination_y = 0.0;
-    if (destination_z < 0) destination_z = 0.0;
-  }
-
-  if (max_software_endstops) {
-    if (destination_x > X_MAX_LENGTH) destination_x = X_MAX_LENGTH;
-    if (destination_y > Y_MAX_LENGTH) destination_y = Y_MAX_LENGTH;
-    if (destination_z > Z_MAX_LENGTH) destination_z = Z_MAX_LENGTH;
-  }
-  
-  if(feedrate > max_feedrate) feedrate = max_feedrate;
-  
-        xdiff=(destination_x - current_x);
-        ydiff=(destination_y - current_y);
-        zdiff=(destination_z - current_z);
-        ediff=(destination_e - current_e);
-        x_steps_to_take = abs(xdiff)*x_steps_per_unit;
-        y_steps_to_take = abs(ydiff)*y_steps_per_unit;
-        z_steps_to_take = abs(zdiff)*z_steps_per_unit;
-        e_steps_to_take = abs(ediff)*e_steps_per_unit;
-        if(feedrate<10)
-            feedrate=10;
-        /*
-        //experimental feedrate calc
-        if(abs(xdiff)>0.1 && abs(ydiff)>0.1)
-            d=sqrt(xdiff*xdiff+ydiff*ydiff);
-        else if(abs(xdiff)>0.1)
-            d=abs(xdiff);
-        else if(abs(ydiff)>0.1)
-            d=abs(ydiff);
-        else if(abs(zdiff)>0.05)
-            d=abs(zdiff);
-        else if(abs(ediff)>0.1)
-            d=abs(ediff);
-        else d=1; //extremely slow move, should be okay for moves under 0.1mm
-        time_for_move=(xdiff/(feedrate/60000000));
-        //time=60000000*dist/feedrate
-        //int feedz=(60000000*zdiff)/time_for_move;
-        //if(feedz>maxfeed)
-        */
-        #define X_TIME_FOR_MOVE ((float)x_steps_to_take / (x_steps_per_unit*feedrate/60000000))
-        #define Y_TIME_FOR_MOVE ((float)y_steps_to_take / (y_steps_per_unit*feedrate/60000000))
-        #define Z_TIME_FOR_MOVE ((float)z_steps_to_take / (z_steps_per_unit*feedrate/60000000))
-        #define E_TIME_FOR_MOVE ((float)e_steps_to_take / (e_steps_per_unit*feedrate/60000000))
-        
-        time_for_move = max(X_TIME_FOR_MOVE,Y_TIME_FOR_MOVE);
-        time_for_move = max(time_for_move,Z_TIME_FOR_MOVE);
-        if(time_for_move <= 0) time_for_move = max(time_for_move,E_TIME_FOR_MOVE);
-
-        if(x_steps_to_take) x_interval = time_for_move/x_steps_to_take*100;
-        if(y_steps_to_take) y_interval = time_for_move/y_steps_to_take*100;
-        if(z_steps_to_take) z_interval = time_for_move/z_steps_to_take*100;
-        if(e_steps_to_take && (x_steps_to_take + y_steps_to_take <= 0)) e_interval = time_for_move/e_steps_to_take*100;
-        
-        //#define DEBUGGING false
-	#if 0        
-	if(0) {
-          Serial.print("destination_x: "); Serial.println(destination_x); 
-          Serial.print("current_x: "); Serial.println(current_x); 
-          Serial.print("x_steps_to_take: "); Serial.println(x_steps_to_take); 
-          Serial.print("X_TIME_FOR_MVE: "); Serial.println(X_TIME_FOR_MOVE); 
-          Serial.print("x_interval: "); Serial.println(x_interval); 
-          Serial.println("");
-          Serial.print("destination_y: "); Serial.println(destination_y); 
-          Serial.print("current_y: "); Serial.println(current_y); 
-          Serial.print("y_steps_to_take: "); Serial.println(y_steps_to_take); 
-          Serial.print("Y_TIME_FOR_MVE: "); Serial.println(Y_TIME_FOR_MOVE); 
-          Serial.print("y_interval: "); Serial.println(y_interval); 
-          Serial.println("");
-          Serial.print("destination_z: "); Serial.println(destination_z); 
-          Serial.print("current_z: "); Serial.println(current_z); 
-          Serial.print("z_steps_to_take: "); Serial.println(z_steps_to_take); 
-          Serial.print("Z_TIME_FOR_MVE: "); Serial.println(Z_TIME_FOR_MOVE); 
-          Serial.print("z_interval: "); Serial.println(z_interval); 
-          Serial.println("");
-          Serial.print("destination_e: "); Serial.println(destination_e); 
-          Serial.print("current_e: "); Serial.println(current_e); 
-          Serial.print("e_steps_to_take: "); Serial.println(e_steps_to_take); 
-          Serial.print("E_TIME_FOR_MVE: "); Serial.println(E_TIME_FOR_MOVE); 
-          Serial.print("e_interval: "); Serial.println(e_interval); 
-          Serial.println("");
-        }
-        #endif 
-         //Determine direction of movement
-  if (destination_x > current_x) digitalWrite(X_DIR_PIN,!INVERT_X_DIR);
-  else digitalWrite(X_DIR_PIN,INVERT_X_DIR);
-  if (destination_y > current_y) digitalWrite(Y_DIR_PIN,!INVERT_Y_DIR);
-  else digitalWrite(Y_DIR_PIN,INVERT_Y_DIR);
-  if (destination_z > current_z) digitalWrite(Z_DIR_PIN,!INVERT_Z_DIR);
-  else digitalWrite(Z_DIR_PIN,INVERT_Z_DIR);
-  if (destination_e > current_e) digitalWrite(E_DIR_PIN,!INVERT_E_DIR);
-  else digitalWrite(E_DIR_PIN,INVERT_E_DIR);
-  
-  if(X_MIN_PIN > -1) if(!direction_x) if(digitalRead(X_MIN_PIN) != ENDSTOPS_INVERTING) x_steps_to_take=0;
-  if(Y_MIN_PIN > -1) if(!direction_y) if(digitalRead(Y_MIN_PIN) != ENDSTOPS_INVERTING) y_steps_to_take=0;
-  if(Z_MIN_PIN > -1) if(!direction_z) if(digitalRead(Z_MIN_PIN) != ENDSTOPS_INVERTING) z_steps_to_take=0;
-  if(X_MAX_PIN > -1) if(direction_x) if(digitalRead(X_MAX_PIN) != ENDSTOPS_INVERTING) x_steps_to_take=0;
-  if(Y_MAX_PIN > -1) if(direction_y) if(digitalRead(Y_MAX_PIN) != ENDSTOPS_INVERTING) y_steps_to_take=0;
-  if(Z_MAX_PIN > -1) if(direction_z) if(digitalRead(Z_MAX_PIN) != ENDSTOPS_INVERTING) z_steps_to_take=0;
-
-   
+  if(ticks_per_second >= 65535.0)
+    return MAX_DDA_RATE;
+  unsigned long rate = ticks_per_second*65536.0 + 0.5;
+  return rate < MIN_DDA_RATE ? MIN_DDA_RATE : rate;
 }
 
-void linear_move(unsigned long x_steps_remaining, unsigned long y_steps_remaining, unsigned long z_steps_remaining, unsigned long e_steps_remaining) // make linear move with preset speeds and destinations, see G0 and G1
+void linear_move() // see G0 and G1
 {
-  //Only enable axis that are moving. If the axis doesn't need to move then it can stay disabled depending on configuration.
-  if(x_steps_remaining) enable_x();
-  if(y_steps_remaining) enable_y();
-  if(z_steps_remaining) { enable_z(); do_z_step(); z_steps_remaining--;}
-  if(e_steps_remaining) {enable_e(); do_e_step(); e_steps_remaining--;}
-  previous_millis_heater = millis();
-  
-  //Define variables that are needed for the Bresenham algorithm. Please note that  Z is not currently included in the Bresenham algorithm.
-  unsigned long start_move_micros = micros(); 
-  unsigned int delta_x = x_steps_remaining;
-  unsigned long x_interval_nanos;
-  unsigned int delta_y = y_steps_remaining;
-  unsigned long y_interval_nanos;
-  unsigned int delta_z = z_steps_remaining;
-  unsigned long z_interval_nanos;
-  boolean steep_y = delta_y > delta_x;// && delta_y > delta_e && delta_y > delta_z;
-  boolean steep_x = delta_x >= delta_y;// && delta_x > delta_e && delta_x > delta_z;
-  //boolean steep_z = delta_z > delta_x && delta_z > delta_y && delta_z > delta_e;
-  int error_x;
-  int error_y;
-  int error_z;
-  unsigned long virtual_full_velocity_steps;
-  unsigned long full_velocity_steps;
-  unsigned long steps_remaining;
-  unsigned long steps_to_take;
-  
-  //Do some Bresenham calculations depending on which axis will lead it.
-  if(steep_y) {
-   error_x = delta_y / 2;
-   previous_micros_y=micros()*100;
-   interval = y_interval;
-   if(e_steps_to_take > 0) virtual_full_velocity_steps = long_full_velocity_units * y_steps_per_unit /100;
-   else virtual_full_velocity_steps = long_travel_move_full_velocity_units * y_steps_per_unit /100;
-   full_velocity_steps = min(virtual_full_velocity_steps, (delta_y - y_min_constant_speed_steps) / 2);
-   steps_remaining = delta_y;
-   steps_to_take = delta_y;
-   max_interval = max_y_interval;
-   min_constant_speed_steps = y_min_constant_speed_steps;
-  } else if (steep_x) {
-   error_y = delta_x / 2;
-   previous_micros_x=micros()*100;
-   interval = x_interval;
-   if(e_steps_to_take > 0) virtual_full_velocity_steps = long_full_velocity_units * x_steps_per_unit /100;
-   else virtual_full_velocity_steps = long_travel_move_full_velocity_units * x_steps_per_unit /100;
-   full_velocity_steps = min(virtual_full_velocity_steps, (delta_x - x_min_constant_speed_steps) / 2);
-   steps_remaining = delta_x;
-   steps_to_take = delta_x;
-   max_interval = max_x_interval;
-   min_constant_speed_steps = x_min_constant_speed_steps;
-  }
-  previous_micros_z=micros()*100;
-  previous_micros_e=micros()*100;
-  acceleration_enabled = true;
-  if(full_velocity_steps == 0) full_velocity_steps++;
-  long full_interval = interval;//max(interval, max_interval - ((max_interval - full_interval) * full_velocity_steps / virtual_full_velocity_steps));
-  if(interval > max_interval) acceleration_enabled = false;
-  if(min_constant_speed_steps >= steps_to_take) {
-    acceleration_enabled = false;
-    full_interval = max(max_interval, interval); // choose the min speed between feedrate and acceleration start speed
+  if(nullmove)
+  {
+    queue_move();
+    return;
   }
-  if(full_velocity_steps < virtual_full_velocity_steps && acceleration_enabled) full_interval = max(interval,
-      max_interval - ((max_interval - full_interval) * full_velocity_steps / virtual_full_velocity_steps)); // choose the min speed between feedrate and speed at full steps
-  unsigned long steps_done = 0;
-  unsigned int steps_acceleration_check = 1;
-  accelerating = acceleration_enabled;
-  
-  //move until no more steps remain 
-  while(x_steps_remaining + y_steps_remaining + z_steps_remaining + e_steps_remaining > 0) {
-    //If acceleration is enabled on this move and we are in the acceleration segment, calculate the current interval
-    if (acceleration_enabled && steps_done < full_velocity_steps && steps_done / full_velocity_steps < 1 && (steps_done % steps_acceleration_check == 0)) {
-      if(steps_done == 0) {
-        interval = max_interval;
-      } else {
-        interval = max_interval - ((max_interval - full_interval) * steps_done / virtual_full_velocity_steps);
-      }
-    } else if (acceleration_enabled && steps_remaining < full_velocity_steps) {
-      //Else, if acceleration is enabled on this move and we are in the deceleration segment, calculate the current interval
-      if(steps_remaining == 0) {
-        interval = max_interval;
-      } else {
-        interval = max_interval - ((max_interval - full_interval) * steps_remaining / virtual_full_velocity_steps);
-      }
-      accelerating = true;
-    } else if (steps_done - full_velocity_steps >= 1 || !acceleration_enabled){
-      //Else, we are just use the full speed interval as current interval
-      interval = full_interval;
-      accelerating = false;
-    }
 
-    //If there are x or y steps remaining, perform Bresenham algorithm
-    if(x_steps_remaining || y_steps_remaining) {
-      if(X_MIN_PIN > -1) if(!direction_x) if(digitalRead(X_MIN_PIN) != ENDSTOPS_INVERTING) break;
-      if(Y_MIN_PIN > -1) if(!direction_y) if(digitalRead(Y_MIN_PIN) != ENDSTOPS_INVERTING) break;
-      if(X_MAX_PIN > -1) if(direction_x) if(digitalRead(X_MAX_PIN) != ENDSTOPS_INVERTING) break;
-      if(Y_MAX_PIN > -1) if(direction_y) if(digitalRead(Y_MAX_PIN) != ENDSTOPS_INVERTING) break;
-      if(steep_y) {
-        timediff = micros() * 100 - previous_micros_y;
-        while(timediff >= interval && y_steps_remaining>0) {
-          steps_done++;
-          steps_remaining--;
-          y_steps_remaining--; timediff-=interval;
-          error_x = error_x - delta_x;
-          do_y_step();
-          if(error_x < 0) {
-            do_x_step(); x_steps_remaining--;
-            error_x = error_x + delta_y;
-          }
-          #ifdef STEP_DELAY_RATIO
-          if(timediff >= interval) delayMicroseconds(long_step_delay_ratio * interval / 10000);
-          #endif
-          #ifdef STEP_DELAY_MICROS
-          if(timediff >= interval) delayMicroseconds(STEP_DELAY_MICROS);
-          #endif
-        }
-      } else if (steep_x) {
-        timediff=micros() * 100 - previous_micros_x;
-        while(timediff >= interval && x_steps_remaining>0) {
-          steps_done++;
-          steps_remaining--;
-          x_steps_remaining--; timediff-=interval;
-          error_y = error_y - delta_y;
-          do_x_step();
-          if(error_y < 0) { 
-            do_y_step(); y_steps_remaining--;
-            error_y = error_y + delta_x;
-          }
-          #ifdef STEP_DELAY_RATIO
-          if(timediff >= interval) delayMicroseconds(long_step_delay_ratio * interval / 10000);
-          #endif
-          #ifdef STEP_DELAY_MICROS
-          if(timediff >= interval) delayMicroseconds(STEP_DELAY_MICROS);
-          #endif
-        }
-      }
-    }
-
-    //If there are z steps remaining, check if z steps must be taken
-    if(z_steps_remaining) {
-      if(Z_MIN_PIN > -1) if(!direction_z) if(digitalRead(Z_MIN_PIN) != ENDSTOPS_INVERTING) break;
-      if(Z_MAX_PIN > -1) if(direction_z) if(digitalRead(Z_MAX_PIN) != ENDSTOPS_INVERTING) break;
-      timediff=micros() * 100-previous_micros_z;
-      while(timediff >= z_interval && z_steps_remaining) {
-        do_z_step();
-        z_steps_remaining--;
-        timediff-=z_interval;
-        #ifdef STEP_DELAY_RATIO
-        if(timediff >= z_interval) delayMicroseconds(long_step_delay_ratio * z_interval / 10000);
-        #endif
-        #ifdef STEP_DELAY_MICROS
-        if(timediff >= z_interval) delayMicroseconds(STEP_DELAY_MICROS);
-        #endif
-      }
-    }
-
-    //If there are e steps remaining, check if e steps must be taken
-    if(e_steps_remaining){
-      if (x_steps_to_take + y_steps_to_take <= 0) timediff=micros() * 100-previous_micros_e;
-      unsigned int final_e_steps_remaining = 0;
-      if (steep_x && x_steps_to_take > 0) final_e_steps_remaining = e_steps_to_take * x_steps_remaining / x_steps_to_take;
-      else if (steep_y && y_steps_to_take > 0) final_e_steps_remaining = e_steps_to_take * y_steps_remaining / y_steps_to_take;
-      //If this move has X or Y steps, let E follow the Bresenham pace
-      if (final_e_steps_remaining > 0)  while(e_steps_remaining > final_e_steps_remaining) { do_e_step(); e_steps_remaining--;}
-      else if (x_steps_to_take + y_steps_to_take > 0)  while(e_steps_remaining) { do_e_step(); e_steps_remaining--;}
-      //Else, normally check if e steps must be taken
-      else while (timediff >= e_interval && e_steps_remaining) {
-        do_e_step();
-        e_steps_remaining--;
-        timediff-=e_interval;
-        #ifdef STEP_DELAY_RATIO
-        if(timediff >= e_interval) delayMicroseconds(long_step_delay_ratio * e_interval / 10000);
-        #endif
-        #ifdef STEP_DELAY_MICROS
-        if(timediff >= e_interval) delayMicroseconds(STEP_DELAY_MICROS);
-        #endif
-      }
-    }
+  float ticks_per_unit = total_steps/distance;
+  float top = min(feedrate/60.0, 65535.0/ticks_per_unit)*ticks_per_unit; // DDA ticks a second
+  float slow = min(min_units_per_second*ticks_per_unit, top);
+  long steady = lround(min_constant_speed_units*ticks_per_unit);
+  long up = 0;
+  
+  acceleration_rate = 0;
+  if(top > slow && total_steps > steady)
+  {
+    float ramp = (destination_e != current_e) ? full_velocity_units : travel_move_full_velocity_units;
+    ramp = max(ramp*ticks_per_unit, 1.0);
     
-    //If more that half second is passed since previous heating check, manage it
-    if(!accelerating && (millis() - previous_millis_heater) >= 500 ) {
-      manage_heater();
-      previous_millis_heater = millis();
-      
-      manage_inactivity(2);
+    // DDA ticks a second per second, then as the interrupt will do it: per
+    // timer tick, with 16 fractional bits
+    
+    float acceleration = (top*top - slow*slow)/(2.0*ramp);
+    acceleration_rate = constrain(lround(acceleration*65536.0/(F_CPU/8.0)), 1, 65535);
+    acceleration = acceleration_rate*(F_CPU/8.0)/65536.0;
+    
+    ramp = (top*top - slow*slow)/(2.0*acceleration);
+    if(2.0*ramp + steady > total_steps)
+    {
+      ramp = (total_steps - steady)/2.0;
+      top = sqrt(slow*slow + 2.0*acceleration*ramp);
     }
-  }
-  
-  if(DISABLE_X) disable_x();
-  if(DISABLE_Y) disable_y();
-  if(DISABLE_Z) disable_z();
-  if(DISABLE_E) disable_e();
+    up = lround(ramp);
+  } else
+    top = slow;
   
-  // Update current position partly based on direction, we probably can combine this with the direction code above...
-  if (destination_x > current_x) current_x = current_x + x_steps_to_take/x_steps_per_unit;
-  else current_x = current_x - x_steps_to_take/x_steps_per_unit;
-  if (destination_y > current_y) current_y = current_y + y_steps_to_take/y_steps_per_unit;
-  else current_y = current_y - y_steps_to_take/y_steps_per_unit;
-  if (destination_z > current_z) current_z = current_z + z_steps_to_take/z_steps_per_unit;
-  else current_z = current_z - z_steps_to_take/z_steps_per_unit;
-  if (destination_e > current_e) current_e = current_e + e_steps_to_take/e_steps_per_unit;
-  else current_e = current_e - e_steps_to_take/e_steps_per_unit;
+  accelerate_until = up;
+  decelerate_after = total_steps - up;
+  initial_rate = to_dda_rate(slow);
+  nominal_rate = to_dda_rate(top);
+  queue_move();
 }
-#endif
 
+#endif
@@ -8,21 +8,13 @@
 //Comment out to disable SD support
 //#define SDSUPPORT 1
 
-//Min step delay in microseconds. If you are experiencing missing steps, try to raise the delay microseconds, but be aware this
-// If you enable this, make sure STEP_DELAY_RATIO is disabled.
-#define STEP_DELAY_MICROS 1
-
 // Do RepRap-style accelerations
 // See: http://reprap.org/wiki/GCodes#G1:_Controlled_move
-// Comment out to get Ordinary G-code F-value behaviour
+// Comment out to get Ordinary G-code F-value behaviour, accelerated with the settings below
 #define REPRAP_ACC
 
-//Step delay over interval ratio. If you are still experiencing missing steps, try to uncomment the following line, but be aware this
-//If you enable this, make sure STEP_DELAY_MICROS is disabled.
-//#define STEP_DELAY_RATIO 0.25
-
-//Acceleration settings
-float full_velocity_units = 10; // the units between minimum and G1 move feedrate
+//Acceleration settings (only used without REPRAP_ACC)
+float full_velocity_units = 10; // the units between minimum and G1 move feedrate, at constant acceleration
 float travel_move_full_velocity_units = 10; // used for travel moves
 float min_units_per_second = 35.0; // the minimum feedrate
 float min_constant_speed_units = 2; // the minimum units of an accelerated move that must be done at constant speed
@@ -73,8 +65,8 @@ float y_steps_per_unit = 80;
 float z_steps_per_unit = 6667.184;
 float e_steps_per_unit = 48;
 
-#ifdef REPRAP_ACC
 float f_steps_per_unit = 1;
+#ifdef REPRAP_ACC
 float max_feedrate = 12000;
 #else
 float max_feedrate = 200000; //mmm, acceleration!
@@ -98,6 +90,9 @@ const bool DISABLE_Y = false;
 const bool DISABLE_Z = false;
 const bool DISABLE_E = false;
 
+//Step pulses are at least this many microseconds long (A4988 drivers need 1, DRV8825s 2)
+#define STEP_PULSE_US 2
+
 const bool INVERT_X_DIR = false;
 const bool INVERT_Y_DIR = false;
 const bool INVERT_Z_DIR = true;
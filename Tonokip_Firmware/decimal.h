@@ -0,0 +1,71 @@
+#ifndef DECIMAL_H
+#define DECIMAL_H
+
+// Read a G-code number: [+-]digits[.digits], after any spaces.  Used instead
+// of strtod(), which is slow on the AVR because it does its sums in floating
+// point and copes with exponents, inf, nan and hex that G-code never has.
+// The digits go into a long, and there is one divide at the end.  The answer
+// is the same as strtod()'s to the last bit for up to 7 significant digits,
+// and within one bit after that.  There are no exponents: an E straight after
+// a number is the next word.  tools/decimal_test.cpp checks it against
+// strtod() on the PC.
+
+float decimal_to_float(const char* str, char** end)
+{
+  const char* p = str;
+  bool negative = false;
+  unsigned long m = 0;
+  byte scale = 0;
+  byte big = 0;
+  bool digits = false;
+  
+  while(*p == ' ' || *p == '\t')
+    p++;
+  if(*p == '-' || *p == '+')
+  {
+    negative = (*p == '-');
+    p++;
+  }
+  for(; *p >= '0' && *p <= '9'; p++)
+  {
+    digits = true;
+    if(m < 429496729)
+      m = m*10 + (*p - '0');
+    else
+      big++;
+  }
+  if(*p == '.')
+  {
+    for(p++; *p >= '0' && *p <= '9'; p++)
+    {
+      digits = true;
+      if(m < 429496729 && !big)
+      {
+        m = m*10 + (*p - '0');
+        scale++;
+      }
+    }
+  }
+  if(!digits)
+  {
+    *end = (char*)str;
+    return 0.0;
+  }
+  *end = (char*)p;
+  
+  float r = (float)m;
+  float d = 1.0;
+  while(scale--)
+    d *= 10.0;
+  r = r/d;
+  if(big)
+  {
+    d = 1.0;
+    while(big--)
+      d *= 10.0;
+    r *= d;
+  }
+  return negative ? -r : r;
+}
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef FEEDRATE_RAMP_H
+#define FEEDRATE_RAMP_H
+
+/*
+
+The F axis ramp for the step interrupt (see "The time between DDA ticks"
+in Tonokip_Firmware.pde).
+
+The DDA tick rate is in proportion to the feedrate, so the interrupt keeps
+F (in F steps) and gets the rate from it with one multiply by the block's
+rate per F step, which queue_move() works out once.  rate_to_ticks() then
+turns the rate into a timer count by interpolating in the tables made by
+createSpeedLookupTable.py.  So an F step is a multiply and a table lookup -
+no loop, and no division unless the DDA is ticking slowly.
+
+Without REPRAP_ACC there's no F axis, and the interrupt keeps the rate
+itself; rate_to_ticks() is all it uses from here.
+
+tools/feedrate_ramp_test.cpp checks these against the division on the PC.
+
+*/
+
+#include "speed_lookuptable.h"
+
+// Rates are DDA ticks a second <<16
+
+#define MAX_DDA_RATE 0xffffffffUL // 65535.99 ticks a second
+#define MIN_DDA_RATE 0x10000UL    // One tick a second
+
+// The rate at F step f.  f_max is MAX_DDA_RATE/step; faster than that
+// goes as fast as the rate can.
+
+inline unsigned long f_to_rate(unsigned long f, unsigned long step, unsigned long f_max)
+{
+  if(f > f_max)
+    return MAX_DDA_RATE;
+  unsigned long rate = f*step;
+  return rate < MIN_DDA_RATE ? MIN_DDA_RATE : rate;
+}
+
+// Timer ticks (clk/8) between DDA ticks at rate.  The fraction of a tick a
+// second (the bottom 16 bits) goes into the interpolation too.  Under
+// DIVIDE_BELOW_RATE ticks a second they're 4ms or more apart, so there's
+// time for a division, and the slow table's chords are a long way off 1/rate
+// at its slow end.
+
+#define DIVIDE_BELOW_RATE 256
+
+inline unsigned long rate_to_ticks(unsigned long rate)
+{
+  if((rate >> 16) < DIVIDE_BELOW_RATE)
+    return ((F_CPU/8UL) << 10)/((rate + 32) >> 6);
+  if((rate >> 16) >= SPEED_TABLE_FAST_RATE)
+  {
+    const unsigned short* entry = speed_lookuptable_fast[rate >> 24];
+    return pgm_read_word(entry) - ((((rate >> 8) & 0xffff)*pgm_read_word(entry + 1) + 0x8000) >> 16);
+  }
+  const unsigned short* entry = speed_lookuptable_slow[rate >> 19];
+  return pgm_read_word(entry) - ((((rate >> 3) & 0xffff)*pgm_read_word(entry + 1) + 0x8000) >> 16);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#!/usr/bin/python
+#
+# Creates the C code lookup tables the firmware uses to turn a step rate
+# into a timer count without doing a division inside the stepping interrupt
+"""Step Rate Lookup Table Generator
+
+Generates step rate to timer ticks lookup tables for use in a microcontroller in C format.
+
+Each table entry is {ticks, gain}: ticks is the timer count for the step rate at the start
+of the entry, gain is how much the count drops by between that entry and the next, so the
+firmware can interpolate linearly between entries with a multiply and a shift.
+
+The fast table covers step rates from 2048 to 65535 per second in steps of 256; the slow
+table covers SPEED_TABLE_MIN_RATE to 2047 per second in steps of 8.  Slower rates than
+that (32 at 16MHz, 40 at 20MHz) don't fit in 16 bits at the chosen prescaler, and have
+to be handled some other way.
+
+Give more than one clock and the tables for each are put in #if F_CPU == ... blocks,
+with an #error for any other clock.
+
+Usage: python createSpeedLookupTable.py [options] > speed_lookuptable.h
+
+Options:
+  -h, --help			show this help
+  --cpu-freq=... 		the processor clock(s) in Hz, separated by commas (default: 16000000,20000000)
+  --prescaler=... 		the timer prescaler the firmware runs the stepping timer at (default: 8)
+"""
+
+import sys
+import getopt
+
+def min_rate(timer_freq):
+	"The slowest step rate, a multiple of 8, whose count fits in 16 bits"
+	rate = 8
+	while timer_freq // rate > 65535:
+		rate += 8
+	return rate
+
+def ticks(timer_freq, rate):
+	"Timer counts between steps at a given step rate, to the nearest count"
+	if rate < min_rate(timer_freq):
+		rate = min_rate(timer_freq)
+	return int(timer_freq / rate + 0.5)
+
+def table(name, timer_freq, step):
+	sys.stdout.write("const unsigned short %s[256][2] PROGMEM = {\n" % (name))
+	for i in range(0, 256):
+		t = ticks(timer_freq, i*step)
+		gain = t - ticks(timer_freq, (i + 1)*step)
+		if i == 255:
+			sys.stdout.write("   {%s, %s}\n" % (t, gain))
+		else:
+			sys.stdout.write("   {%s, %s},\n" % (t, gain))
+	sys.stdout.write("};\n")
+
+def main(argv):
+
+	cpu_freqs = [16000000, 20000000]
+	prescaler = int(8);
+
+	try:
+		opts, args = getopt.getopt(argv, "h", ["help", "cpu-freq=", "prescaler="])
+	except getopt.GetoptError:
+		usage()
+		sys.exit(2)
+
+	for opt, arg in opts:
+		if opt in ("-h", "--help"):
+			usage()
+			sys.exit()
+		elif opt == "--cpu-freq":
+			cpu_freqs = [int(f) for f in arg.split(",")]
+		elif opt == "--prescaler":
+			prescaler = int(arg)
+
+	sys.stdout.write("#ifndef SPEED_LOOKUPTABLE_H\n")
+	sys.stdout.write("#define SPEED_LOOKUPTABLE_H\n\n")
+	sys.stdout.write("// Step rate to timer ticks lookup tables for the stepping interrupt\n")
+	sys.stdout.write("// Made with createSpeedLookupTable.py\n")
+	sys.stdout.write("// ./createSpeedLookupTable.py --cpu-freq=%s --prescaler=%s\n\n" % (",".join([str(f) for f in cpu_freqs]), prescaler))
+	sys.stdout.write("#define SPEED_TABLE_PRESCALER %s\n" % (prescaler))
+	sys.stdout.write("#define SPEED_TABLE_FAST_RATE 2048 // Use the fast table from here up\n\n")
+	for n, cpu_freq in enumerate(cpu_freqs):
+		timer_freq = cpu_freq//prescaler
+		if len(cpu_freqs) > 1:
+			sys.stdout.write("%s F_CPU == %s\n\n" % ("#if" if n == 0 else "#elif", cpu_freq))
+		sys.stdout.write("// timer ticks per second: %s\n\n" % (timer_freq))
+		sys.stdout.write("#define SPEED_TABLE_MIN_RATE %s    // Slower than this and the count won't fit in 16 bits\n\n" % (min_rate(timer_freq)))
+		table("speed_lookuptable_fast", timer_freq, 256)
+		sys.stdout.write("\n")
+		table("speed_lookuptable_slow", timer_freq, 8)
+		sys.stdout.write("\n")
+	if len(cpu_freqs) > 1:
+		sys.stdout.write("#else\n")
+		sys.stdout.write("#error No step rate tables for this F_CPU - make them with createSpeedLookupTable.py\n")
+		sys.stdout.write("#endif\n")
+	sys.stdout.write("\n#endif\n")
+
+def usage():
+	sys.stdout.write(__doc__)
+
+if __name__ == "__main__":
+	main(sys.argv[1:])
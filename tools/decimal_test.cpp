@@ -0,0 +1,259 @@
+// Checks the firmwares' G-code number readers against strtod(), and times
+// them.  Runs on the PC:
+//
+//   g++ -O2 -o decimal_test tools/decimal_test.cpp && ./decimal_test
+//
+// Both readers are checked: Tonokip's decimal_to_float() (Tonokip_Firmware/
+// decimal.h), and FiveD's, which is fed a character at a time as the line
+// arrives (FiveD_GCode/FiveD_GCode_Interpreter/gcode_number.h).  For every
+// string they must stop where strtod() does and give (float)strtod() to the
+// last bit when the digits fit in a float's 24 bits, and within one bit when
+// they don't.  The strings are every value from -1000 to 1000 at 0 to 3
+// decimals, E from 0 to 100 in steps of 0.00001, F from 0 to 30000 as whole
+// numbers and to 0.1, a million random ones of up to 15 digits, and the odd
+// forms by hand.
+//
+// The one place they are meant to differ is exponents: G-code has none, so
+// "1E5" is 1 followed by the E word, where strtod() would read 100000.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <chrono>
+
+typedef uint8_t byte;
+
+#include "../Tonokip_Firmware/decimal.h"
+#include "../FiveD_GCode/FiveD_GCode_Interpreter/gcode_number.h"
+
+static long long checked = 0;
+static int failures = 0;
+
+// FiveD's reader, as parse_char() drives it: how many characters of s it
+// takes as the number of word w, and the number, if it had any digits.
+
+static int fived_read(char w, const char* s, float& f, bool& digits)
+{
+  LineParser lp;
+  start_word(lp, w);
+  int i = 0;
+  while(s[i] && number_char(lp, s[i]))
+    i++;
+  digits = lp.digits;
+  f = digits ? word_float(lp) : 0.0;
+  return i;
+}
+
+// Do the digits of s, without the point, fit in a float exactly?
+
+static bool fits_24_bits(const char* s)
+{
+  unsigned long long m = 0;
+  for(; *s && *s != 'E' && *s != 'e'; s++)
+    if(*s >= '0' && *s <= '9')
+    {
+      m = m*10 + (*s - '0');
+      if(m >= (1ULL << 24))
+        return false;
+    }
+  return true;
+}
+
+// Bits apart, for floats of the same sign
+
+static long ulps(float a, float b)
+{
+  int32_t ia, ib;
+  memcpy(&ia, &a, 4);
+  memcpy(&ib, &b, 4);
+  if((ia < 0) != (ib < 0))
+    return (a == b) ? 0 : 0x7fffffff;
+  return labs((long)ia - (long)ib);
+}
+
+static void fail(const char* who, const char* s, int used, int want_used, float f, float want)
+{
+  if(failures++ < 20)
+    printf("FAIL %s \"%s\": took %d chars, %.9g; strtod() took %d, %.9g\n",
+           who, s, used, f, want_used, want);
+}
+
+// Check both readers against strtod() for s
+
+static void check(const char* s)
+{
+  char* end;
+  float want = strtod(s, &end);
+  int want_used = end - s;
+  const char* e = strpbrk(s, "eE");
+  if(e && e - s < want_used)
+  {
+    // An exponent; the readers should stop at the E
+    want_used = e - s;
+    char mantissa[64];
+    memcpy(mantissa, s, want_used);
+    mantissa[want_used] = 0;
+    want = strtod(mantissa, &end);
+  }
+  long allowed = fits_24_bits(s) ? 0 : 1;
+  checked++;
+
+  float f = decimal_to_float(s, &end);
+  int used = end - s;
+  if(used != want_used || ulps(f, want) > allowed)
+    fail("decimal_to_float()", s, used, want_used, f, want);
+
+  bool digits;
+  used = fived_read('X', s, f, digits);
+  if(!want_used)
+  {
+    if(digits)
+      fail("FiveD", s, used, want_used, f, want);
+  } else if(used != want_used || ulps(f, want) > allowed)
+    fail("FiveD", s, used, want_used, f, want);
+}
+
+// FiveD's whole-number words stop at the point, as strtol() does
+
+static void check_integer(const char* s)
+{
+  char* end;
+  long want = strtol(s, &end, 10);
+  int want_used = end - s;
+  float f;
+  bool digits;
+  int used = fived_read('G', s, f, digits);
+  checked++;
+  if(!want_used)
+  {
+    if(digits)
+      fail("FiveD G", s, used, want_used, f, want);
+  } else if(used != want_used || (long)f != want)
+    fail("FiveD G", s, used, want_used, f, want);
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t random32()
+{
+  seed = seed*1664525 + 1013904223;
+  return seed >> 1;
+}
+
+static const char* odd_ones[] = {
+  "0", "-0", "+0", "0.", ".0", ".5", "-.5", "+.5", "5.", "-5.", "+1.5",
+  "  12.5", " -3", "007", "0.000", "00.0010", "1.", "-", "+", ".", "-.",
+  " ", "", "X", "1.2.3", "1-2", "1 2", "12X", "12.5E3", "1E5", "1e5", "2.5e-3",
+  "4294967295", "4294967296", "12345678901234567890", "0.1234567890123",
+  "429496729.5", "999999999.99", "16777216", "16777217", "0.00000001",
+  "123456.789012", "-98765.4321", "3.14159265358979",
+  0
+};
+
+static const char* integers[] = {
+  "28", "1", "-1", "0", "1.5", "23.", "999", "  104", "+5", "-", "", 0
+};
+
+// Time one reader over the strings, in ns per number
+
+template <class Reader> static double time_it(Reader read, char** strings, int n, float& sum)
+{
+  const int passes = 5;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(int p = 0; p < passes; p++)
+    for(int i = 0; i < n; i++)
+      sum += read(strings[i]);
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(t1 - t0).count()/(passes*(double)n);
+}
+
+static float by_strtod(const char* s) { return strtod(s, 0); }
+static float by_decimal_to_float(const char* s) { char* e; return decimal_to_float(s, &e); }
+static float by_fived(const char* s) { float f; bool d; fived_read('E', s, f, d); return f; }
+
+int main()
+{
+  char s[64];
+
+  for(int i = 0; odd_ones[i]; i++)
+    check(odd_ones[i]);
+  for(int i = 0; integers[i]; i++)
+    check_integer(integers[i]);
+
+  // -1000 to 1000 at 0 to 3 decimals
+
+  for(int decimals = 0, scale = 1; decimals <= 3; decimals++, scale *= 10)
+    for(long v = -1000L*scale; v <= 1000L*scale; v++)
+    {
+      snprintf(s, sizeof(s), "%.*f", decimals, (double)v/scale);
+      check(s);
+    }
+
+  // E from 0 to 100 in 0.00001s
+
+  for(long v = 0; v <= 10000000L; v++)
+  {
+    snprintf(s, sizeof(s), "%ld.%05ld", v/100000, v%100000);
+    check(s);
+  }
+
+  // F as whole numbers and to 0.1
+
+  for(long v = 0; v <= 300000L; v++)
+  {
+    snprintf(s, sizeof(s), "%ld", v/10);
+    check(s);
+    snprintf(s, sizeof(s), "%ld.%ld", v/10, v%10);
+    check(s);
+  }
+
+  // Random ones with up to 15 digits, the point anywhere, and spaces and signs
+
+  for(int i = 0; i < 1000000; i++)
+  {
+    int n = 0;
+    for(int sp = random32() % 3; sp; sp--)
+      s[n++] = ' ';
+    switch(random32() % 4)
+    {
+      case 0: s[n++] = '-'; break;
+      case 1: s[n++] = '+'; break;
+      default: break;
+    }
+    int digits = 1 + random32() % 15;
+    int point = random32() % (digits + 2);
+    for(int d = 0; d < digits; d++)
+    {
+      if(d == point)
+        s[n++] = '.';
+      s[n++] = '0' + random32() % 10;
+    }
+    s[n] = 0;
+    check(s);
+  }
+
+  printf("%lld strings checked, %d failures\n", checked, failures);
+
+  // How long they take, over a mix of typical E and F values
+
+  const int n = 200000;
+  static char buffers[n][16];
+  static char* strings[n];
+  for(int i = 0; i < n; i++)
+  {
+    if(i & 1)
+      snprintf(buffers[i], 16, "%ld.%05ld", (long)(random32() % 100), (long)(random32() % 100000));
+    else
+      snprintf(buffers[i], 16, "%ld", (long)(random32() % 6000));
+    strings[i] = buffers[i];
+  }
+  float sum = 0;
+  double t_strtod = time_it(by_strtod, strings, n, sum);
+  double t_decimal = time_it(by_decimal_to_float, strings, n, sum);
+  double t_fived = time_it(by_fived, strings, n, sum);
+  printf("ns per number: strtod() %.1f, decimal_to_float() %.1f, FiveD %.1f (%g)\n",
+         t_strtod, t_decimal, t_fived, sum);
+
+  return failures ? 1 : 0;
+}
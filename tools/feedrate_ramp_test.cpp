@@ -0,0 +1,174 @@
+// Checks the Tonokip step interrupt's F ramp (Tonokip_Firmware/feedrate_ramp.h)
+// against doing the division every F step.  Runs on the PC:
+//
+//   g++ -O2 -o feedrate_ramp_test tools/feedrate_ramp_test.cpp && ./feedrate_ramp_test
+//
+// Add -DF_CPU=20000000 to check the 20MHz tables.
+//
+// rate_to_ticks() is checked against the exact count for rates from one to
+// 65535 DDA ticks a second.  Then for ramps made the way setup_move() and
+// queue_move() make them, every F step's rate (f_to_rate()) is checked
+// against F*total_steps/(60*distance), and the time the whole ramp takes
+// against the sum of the exact times.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000
+#endif
+
+#define PROGMEM
+#define pgm_read_word(p) (*(const unsigned short*)(p))
+
+// The firmware's longs are 32 bits, so make them so here too
+
+#define long int
+#include "../Tonokip_Firmware/feedrate_ramp.h"
+#undef long
+
+static const double timer_freq = F_CPU/8.0;
+
+// Timer ticks are exact to within this fraction plus one tick: the fast
+// table's chords are 256 ticks a second long, and at its slow end (2048 ticks
+// a second) they're up to 0.35% off 1/rate; and the timer counts whole ticks.
+// A ramp's time is allowed the same, a tick for each DDA tick.
+
+static const double ticks_allowed = 0.004;
+
+static double worst_ticks = 0, worst_rate = 0, worst_ramp = 0;
+static long long ramps = 0, f_steps = 0;
+
+static double relative(double a, double b)
+{
+  return fabs(a - b)/b;
+}
+
+static bool check_ticks()
+{
+  bool ok = true;
+  for(uint64_t rate = MIN_DDA_RATE; rate <= MAX_DDA_RATE; rate += 97)
+  {
+    double want = timer_freq*65536.0/rate;
+    double got = rate_to_ticks(rate);
+    double e = relative(got, want);
+    if(e > worst_ticks)
+      worst_ticks = e;
+    if(fabs(got - want) > ticks_allowed*want + 1.0)
+    {
+      printf("FAIL rate_to_ticks(%.3f ticks a second) = %.0f, should be %.1f\n", rate/65536.0, got, want);
+      ok = false;
+      break;
+    }
+  }
+  return ok;
+}
+
+// Ramp F from f0 to f1 (mm/minute) over a move of distance mm that's
+// total_steps DDA ticks long, the way the firmware does it: F is in steps
+// of t_scale.  False if anything's wrong.
+
+static bool ramp(double distance, int32_t total_steps, int32_t t_scale, int32_t f0, int32_t f1)
+{
+  uint32_t rate_step = lround(65536.0*t_scale*total_steps/(60.0*distance));
+  if(rate_step < 1)
+    rate_step = 1;
+  uint32_t fast_f = MAX_DDA_RATE/rate_step;
+  uint32_t f = f0;
+  double t = 0, t_exact = 0;
+  long n = 0;
+
+  ramps++;
+  for(;;)
+  {
+    double exact = (double)f*t_scale*total_steps/(60.0*distance);
+    double rate = f_to_rate(f, rate_step, fast_f)/65536.0;
+    if(exact >= 1.0 && exact <= 65535.0)
+    {
+      double e = relative(rate, exact);
+      if(e > worst_rate)
+        worst_rate = e;
+      if(e > 0.0001)
+      {
+        printf("FAIL distance %g steps %ld t_scale %ld at F %ld: rate %g, should be %g\n",
+               distance, (long)total_steps, (long)t_scale, (long)f, rate, exact);
+        return false;
+      }
+      t += rate_to_ticks(f_to_rate(f, rate_step, fast_f));
+      t_exact += timer_freq/exact;
+      n++;
+    }
+    if(f == (uint32_t)f1)
+      break;
+    f += (f1 > f0) ? 1 : -1;
+    f_steps++;
+  }
+  if(t_exact > 0)
+  {
+    double e = relative(t, t_exact);
+    if(e > worst_ramp)
+      worst_ramp = e;
+    if(fabs(t - t_exact) > ticks_allowed*t_exact + n)
+    {
+      printf("FAIL distance %g steps %ld t_scale %ld F %ld -> %ld: took %.0f ticks, should be %.0f\n",
+             distance, (long)total_steps, (long)t_scale, (long)f0, (long)f1, t, t_exact);
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint32_t seed = 12345;
+
+static uint32_t random32()
+{
+  seed = seed*1664525 + 1013904223;
+  return seed;
+}
+
+static double random_between(double lo, double hi)
+{
+  return lo + (hi - lo)*(random32() % 1000001)/1000000.0;
+}
+
+int main()
+{
+  int failures = 0;
+
+  if(!check_ticks())
+    failures++;
+
+  // Random moves: 48 to 6667 steps/mm (the E and Z of the default
+  // configuration.h), 0.01 to 300mm, F between 10 and 12000 mm/minute
+
+  for(int i = 0; i < 200000 && failures < 10; i++)
+  {
+    double steps_per_mm = random_between(48, 6667);
+    double distance = random_between(0.01, 300);
+    int32_t total_steps = lround(steps_per_mm*distance);
+    if(total_steps < 1)
+      continue;
+    int32_t f0 = 10 + random32() % 11991;
+    int32_t f1 = 10 + random32() % 11991;
+
+    // setup_move()'s rescale, so F doesn't take more steps than the move
+
+    int32_t t_scale = 1;
+    if(labs(f1 - f0) > total_steps)
+    {
+      t_scale = labs(f1 - f0)/total_steps + 1;
+      f0 /= t_scale;
+      f1 /= t_scale;
+      if(f0 < 1) f0 = 1;
+      if(f1 < 1) f1 = 1;
+    }
+    if(!ramp(distance, total_steps, t_scale, f0, f1))
+      failures++;
+  }
+
+  printf("F_CPU %ld: %lld ramps, %lld F steps, %d failures\n", (long)F_CPU, ramps, f_steps, failures);
+  printf("worst errors: rate_to_ticks() %.4f%%, f_to_rate() %.5f%%, ramp time %.4f%%\n",
+         100*worst_ticks, 100*worst_rate, 100*worst_ramp);
+  return failures ? 1 : 0;
+}